@@ -0,0 +1,59 @@
+//Phase timing and JSON output shared by the promotion pass and the graph coloring
+//allocator for their -*-stats-file reports
+
+#ifndef PHASE_TIMER_H
+#define PHASE_TIMER_H
+
+#include "llvm/Pass.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+
+//Times a phase under -time-passes, and adds its wall time to a total of the
+//function for the statistics file. When a phase runs other timed phases, the time
+//they add to their own total can be left out of this one, so that no time is
+//reported twice.
+class PhaseTimer
+{
+	llvm::NamedRegionTimer Timer;
+	double &Total;
+	double Start;
+	const double *Nested;
+	double NestedStart;
+
+	public:
+		PhaseTimer(const char *name, const char *group, double &total, const double *nested = 0)
+			: Timer(name, group, llvm::TimePassesIsEnabled),
+			  Total(total), Start(llvm::TimeRecord::getCurrentTime(true).getWallTime()),
+			  Nested(nested), NestedStart(nested ? *nested : 0) {}
+
+		~PhaseTimer()
+		{
+			Total += llvm::TimeRecord::getCurrentTime(false).getWallTime() - Start;
+			if(Nested)
+				Total -= *Nested - NestedStart;
+		}
+};
+
+//writes a JSON string literal
+inline void writeJSONString(llvm::raw_ostream &os, llvm::StringRef str)
+{
+	os << '"';
+	static const char hex[] = "0123456789abcdef";
+	for(unsigned i = 0; i != str.size(); i++)
+	{
+		unsigned char c = str[i];
+		//control characters are not allowed unescaped in a JSON string
+		if(c < 0x20)
+			os << "\\u00" << hex[c >> 4] << hex[c & 15];
+		else
+		{
+			if(c == '"' || c == '\\')
+				os << '\\';
+			os << str[i];
+		}
+	}
+	os << '"';
+}
+
+#endif
@@ -1,18 +1,25 @@
 #define DEBUG_TYPE "regalloc"
 #include "RenderMachineFunction.h"
 #include "llvm/Function.h"
+#include "llvm/Module.h"
+#include "llvm/Pass.h"
 #include "VirtRegRewriter.h"
 #include "VirtRegMap.h"
 #include "Spiller.h"
+#include "SplitKit.h"
+#include "PhaseTimer.h"
 #include "llvm/CodeGen/RegisterCoalescer.h"
 #include "llvm/CodeGen/LiveIntervalAnalysis.h"
 #include "llvm/CodeGen/LiveStackAnalysis.h"
+#include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineInstr.h"
 #include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/MachineMemOperand.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/Passes.h"
+#include "llvm/CodeGen/PseudoSourceValue.h"
 #include "llvm/CodeGen/RegAllocRegistry.h"
 #include "llvm/Target/TargetRegisterInfo.h"
 #include "llvm/Target/TargetMachine.h"
@@ -21,28 +28,605 @@
 #include "llvm/ADT/EquivalenceClasses.h"
 #include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/Compiler.h"
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Config/llvm-config.h"
 #include <algorithm>
 #include <set>
 #include <map>
 #include <queue>
 #include <memory>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
+//LLVM_MULTITHREADED is set on Windows as well, where there is no pthread: the
+//graph is then built by the serial loop
+#if defined(LLVM_MULTITHREADED) && LLVM_MULTITHREADED && defined(LLVM_ON_UNIX)
+#define COLOR_PTHREADS 1
+#include <pthread.h>
+#endif
 
 using namespace llvm;
 using namespace std;
 
+namespace llvm {
+	FunctionPass *createPriorityColorRegisterAllocator();
+}
+
+STATISTIC(NumCoalesced, "Number of copies coalesced");
+STATISTIC(NumOptimistic, "Number of potential spills colored optimistically");
+STATISTIC(NumSplits, "Number of intervals split instead of spilled");
+STATISTIC(NumRemats, "Number of spilled registers rematerialized");
+STATISTIC(NumReloadsAvoided, "Number of reloads replaced by rematerialization");
+STATISTIC(NumLoopSplits, "Number of intervals split around a loop they are not redefined in");
+STATISTIC(NumDynamicSpillsAvoided, "Estimated dynamic spill instructions moved out of loops");
+STATISTIC(NumSlotsMerged, "Number of spill slots merged into another slot");
+STATISTIC(NumFrameBytesSaved, "Number of stack frame bytes saved by merging spill slots");
+STATISTIC(NumCacheHits, "Number of functions allocated from the allocation cache");
+STATISTIC(NumCacheRejected, "Number of allocation cache entries that failed validation");
+STATISTIC(NumLinearScanFallbacks, "Number of functions over budget allocated by linear scan");
+
+//the -time-passes group of the phase timers; spills happen while select runs, so
+//the select timer leaves out the spill time
+static const char *const TimerGroup = "Graph Coloring Register Allocator";
+
 static RegisterRegAlloc
 GraphColorRegAlloc("color1", "graph coloring register allocator",
             createColorRegisterAllocator);
 
+static RegisterRegAlloc
+PriorityColorRegAlloc("color-priority", "priority-based graph coloring register allocator",
+            createPriorityColorRegisterAllocator);
+
+static cl::opt<bool>
+SweepInterference("color-sweep-interference",
+		cl::desc("Build the interference graph by sweeping sorted live segments"),
+		cl::init(true), cl::Hidden);
+
+static cl::opt<unsigned>
+ParallelBuildThreshold("color-parallel-build-threshold",
+		cl::desc("Build the interference graph on several threads above this many virtual registers"),
+		cl::init(10000), cl::Hidden);
+
+static cl::opt<unsigned>
+ParallelBuildThreads("color-build-threads",
+		cl::desc("Number of threads building the interference graph of a large function"),
+		cl::init(4), cl::Hidden);
+
+static cl::opt<unsigned>
+MaxVirtRegs("color-max-vregs",
+		cl::desc("Use the linear scan fallback above this many virtual registers (0 = no limit)"),
+		cl::init(0), cl::Hidden);
+
+static cl::opt<unsigned>
+MaxEdges("color-max-edges",
+		cl::desc("Use the linear scan fallback above this many interference edges (0 = no limit)"),
+		cl::init(0), cl::Hidden);
+
+static cl::opt<unsigned>
+MaxRounds("color-max-rounds",
+		cl::desc("Use the linear scan fallback after this many spill rounds (0 = no limit)"),
+		cl::init(0), cl::Hidden);
+
+static cl::opt<bool>
+IncrementalRounds("color-incremental",
+		cl::desc("Update the interference graph across spill rounds instead of rebuilding it"),
+		cl::init(false), cl::Hidden);
+
+static cl::opt<bool>
+SplitBeforeSpill("color-split",
+		cl::desc("Split live ranges around loops and blocks before spilling them"),
+		cl::init(true), cl::Hidden);
+
+static cl::opt<bool>
+LoopAwareSpills("color-loop-spills",
+		cl::desc("Keep values not redefined in a loop in a register inside the loop, and reload them in the preheader "
+			"(independent of -color-split)"),
+		cl::init(true), cl::Hidden);
+
+static cl::opt<bool>
+ColorStackSlots("color-stack-slots",
+		cl::desc("Merge spill slots whose live ranges do not overlap"),
+		cl::init(true), cl::Hidden);
+
+static cl::opt<std::string>
+StatsFile("color-stats-file",
+		cl::desc("Append one JSON line of allocation statistics per function to this file"),
+		cl::init(""), cl::Hidden);
+
+static cl::opt<std::string>
+CacheDir("color-cache-dir",
+		cl::desc("Reuse the allocation of unchanged functions from this directory"),
+		cl::init(""), cl::Hidden);
+
+static cl::opt<bool>
+CoalesceCopies("color-coalesce",
+		cl::desc("Conservatively coalesce copies while simplifying the graph"),
+		cl::init(true), cl::Hidden);
+
 namespace {
-	map<unsigned, set<unsigned> > InterferenceGraph;
-	map<unsigned, int> Degree;
-   	map<unsigned, bool> OnStack;
-	set<unsigned> Colored;
-	BitVector Allocatable;
-	set<unsigned> PhysicalRegisters;
+	//Interference graph over virtual registers, in the Chaitin-Briggs layout. Nodes
+	//are numbered by TargetRegisterInfo::virtReg2Index. A triangular bit matrix
+	//answers interferes(a,b) in constant time, and the adjacency vectors are used
+	//to walk the neighbours of a node.
+	class ColorGraph
+	{
+		vector<uint64_t> Matrix;
+		vector<vector<unsigned> > AdjList;
+		BitVector Present;
+		vector<unsigned> Nodes;
+		unsigned NumEdges;
+
+		static size_t bitIndex(unsigned a, unsigned b)
+		{
+			if(a < b)
+				std::swap(a, b);
+			return (size_t)a * (a - 1) / 2 + b;
+		}
+
+		public:
+			ColorGraph() : NumEdges(0) {}
+
+			//sizes the graph for node indices [0, numNodes)
+			void init(unsigned numNodes)
+			{
+				clear();
+				Matrix.resize(((size_t)numNodes * numNodes / 2 + 63) / 64, 0);
+				AdjList.resize(numNodes);
+				Present.resize(numNodes);
+			}
+
+			void clear()
+			{
+				Matrix.clear();
+				AdjList.clear();
+				Present.clear();
+				Nodes.clear();
+				NumEdges = 0;
+			}
+
+			//makes room for node indices [0, numNodes), keeping the nodes and edges
+			//that are already there
+			void grow(unsigned numNodes)
+			{
+				if(numNodes <= AdjList.size())
+					return;
+				Matrix.resize(((size_t)numNodes * numNodes / 2 + 63) / 64, 0);
+				AdjList.resize(numNodes);
+				Present.resize(numNodes);
+			}
+
+			void addNode(unsigned n)
+			{
+				if(Present.test(n))
+					return;
+				Present.set(n);
+				Nodes.push_back(n);
+			}
+
+			//deletes a node together with all of its edges
+			void removeNode(unsigned n)
+			{
+				if(!hasNode(n))
+					return;
+				for(vector<unsigned>::iterator ii = AdjList[n].begin(); ii != AdjList[n].end(); ii++)
+				{
+					vector<unsigned> &adj = AdjList[*ii];
+					adj.erase(std::find(adj.begin(), adj.end(), n));
+					size_t bit = bitIndex(n, *ii);
+					Matrix[bit / 64] &= ~((uint64_t)1 << (bit % 64));
+					NumEdges--;
+				}
+				AdjList[n].clear();
+				Present.reset(n);
+				Nodes.erase(std::find(Nodes.begin(), Nodes.end(), n));
+			}
+
+			bool hasNode(unsigned n) const
+			{
+				return n < Present.size() && Present.test(n);
+			}
+
+			bool interferes(unsigned a, unsigned b) const
+			{
+				if(a == b)
+					return false;
+				size_t bit = bitIndex(a, b);
+				return (Matrix[bit / 64] >> (bit % 64)) & 1;
+			}
+
+			//returns false if the edge was already there
+			bool addEdge(unsigned a, unsigned b)
+			{
+				if(a == b || interferes(a, b))
+					return false;
+				size_t bit = bitIndex(a, b);
+				Matrix[bit / 64] |= (uint64_t)1 << (bit % 64);
+				AdjList[a].push_back(b);
+				AdjList[b].push_back(a);
+				NumEdges++;
+				return true;
+			}
+
+			//puts nodes and neighbours in index order, so that walking the graph does
+			//not depend on the order in which edges were discovered
+			void finalize()
+			{
+				std::sort(Nodes.begin(), Nodes.end());
+				for(vector<unsigned>::iterator ii = Nodes.begin(); ii != Nodes.end(); ii++)
+					std::sort(AdjList[*ii].begin(), AdjList[*ii].end());
+			}
+
+			const vector<unsigned> &adjacent(unsigned n) const { return AdjList[n]; }
+			unsigned degree(unsigned n) const { return AdjList[n].size(); }
+			const vector<unsigned> &nodes() const { return Nodes; }
+			unsigned numNodes() const { return Nodes.size(); }
+			unsigned numEdges() const { return NumEdges; }
+	};
+
+	//Nodes kept in buckets by their current degree. Inserting, removing and moving
+	//a node between buckets are constant time. The minimum only moves down when a
+	//degree drops below it, so finding the lowest non-empty bucket is amortized
+	//constant time over a whole simplify phase.
+	class DegreeBuckets
+	{
+		vector<vector<unsigned> > Buckets;
+		vector<unsigned> Position;
+		vector<int> BucketOf;
+		unsigned Min;
+		unsigned Size;
+
+		public:
+			DegreeBuckets() : Min(0), Size(0) {}
+
+			void init(unsigned numNodes)
+			{
+				Buckets.clear();
+				Position.assign(numNodes, 0);
+				BucketOf.assign(numNodes, -1);
+				Min = 0;
+				Size = 0;
+			}
+
+			bool contains(unsigned n) const { return BucketOf[n] != -1; }
+			bool empty() const { return Size == 0; }
+
+			void insert(unsigned n, unsigned degree)
+			{
+				if(degree >= Buckets.size())
+					Buckets.resize(degree + 1);
+				Position[n] = Buckets[degree].size();
+				Buckets[degree].push_back(n);
+				BucketOf[n] = degree;
+				if(Size == 0 || degree < Min)
+					Min = degree;
+				Size++;
+			}
+
+			void remove(unsigned n)
+			{
+				vector<unsigned> &bucket = Buckets[BucketOf[n]];
+				unsigned last = bucket.back();
+				bucket[Position[n]] = last;
+				Position[last] = Position[n];
+				bucket.pop_back();
+				BucketOf[n] = -1;
+				Size--;
+			}
+
+			void update(unsigned n, unsigned degree)
+			{
+				if(!contains(n) || (unsigned)BucketOf[n] == degree)
+					return;
+				remove(n);
+				insert(n, degree);
+			}
+
+			//returns a node of minimum degree, the bucket set must not be empty
+			unsigned min()
+			{
+				while(Buckets[Min].empty())
+					Min++;
+				return Buckets[Min].back();
+			}
+	};
+
+	//a copy between two virtual registers, in the sense of Appel's worklists
+	struct CopyMove
+	{
+		enum MoveState { Worklist, Active, Coalesced, Constrained, Frozen };
+
+		unsigned Dst, Src;
+		MoveState State;
+
+		CopyMove(unsigned d, unsigned s) : Dst(d), Src(s), State(Worklist) {}
+	};
+
+	//a node that may be pushed as a potential spill, ordered by spill cost over the
+	//degree it had when it was queued
+	struct SpillCandidate
+	{
+		float Priority;
+		unsigned Node;
+		int Degree;
+
+		SpillCandidate(float p, unsigned n, int d) : Priority(p), Node(n), Degree(d) {}
+
+		bool operator>(const SpillCandidate &other) const
+		{
+			if(Priority != other.Priority)
+				return Priority > other.Priority;
+			return Node > other.Node;
+		}
+	};
+
+	//Live segments occupying each physical register: those of its fixed interval and
+	//those of the virtual registers colored with it. The segments of a register are
+	//kept disjoint in a map from start to end, so adding a range and asking about one
+	//are both logarithmic in the number of segments.
+	class RegOccupancy
+	{
+		typedef map<SlotIndex, SlotIndex> SegmentMap;
+		vector<SegmentMap> Segments;
+
+		public:
+			void init(unsigned numRegs)
+			{
+				Segments.clear();
+				Segments.resize(numRegs);
+			}
+
+			void clear()
+			{
+				Segments.clear();
+			}
+
+			//marks the ranges of the interval as occupied in the register
+			void add(unsigned reg, const LiveInterval &li)
+			{
+				SegmentMap &segs = Segments[reg];
+				for(LiveInterval::const_iterator ri = li.begin(); ri != li.end(); ri++)
+				{
+					SlotIndex start = ri->start, end = ri->end;
+					SegmentMap::iterator first = segs.lower_bound(start);
+					if(first != segs.begin())
+					{
+						SegmentMap::iterator prev = first;
+						prev--;
+						if(start <= prev->second)
+							first = prev;
+					}
+					SegmentMap::iterator last = first;
+					//absorb every segment touching the new one
+					while(last != segs.end() && last->first <= end)
+					{
+						if(last->first < start)
+							start = last->first;
+						if(end < last->second)
+							end = last->second;
+						last++;
+					}
+					segs.erase(first, last);
+					segs.insert(last, make_pair(start, end));
+				}
+			}
+
+			//checks if any range of the interval overlaps a segment of the register
+			bool overlaps(unsigned reg, const LiveInterval &li) const
+			{
+				const SegmentMap &segs = Segments[reg];
+				if(segs.empty())
+					return false;
+				for(LiveInterval::const_iterator ri = li.begin(); ri != li.end(); ri++)
+				{
+					SegmentMap::const_iterator si = segs.lower_bound(ri->start);
+					if(si != segs.end() && si->first < ri->end)
+						return true;
+					if(si != segs.begin())
+					{
+						si--;
+						if(ri->start < si->second)
+							return true;
+					}
+				}
+				return false;
+			}
+	};
+
+	//per node bit sets that may not cover the newest virtual registers yet
+	void setNodeBit(BitVector &bits, unsigned node)
+	{
+		if(node >= bits.size())
+			bits.resize(node + 1);
+		bits.set(node);
+	}
+
+	bool testNodeBit(const BitVector &bits, unsigned node)
+	{
+		return node < bits.size() && bits.test(node);
+	}
+
+	//a single live range of a virtual register, ordered by the partition of the
+	//register and then by its start index
+	struct LiveSegment
+	{
+		SlotIndex start, end;
+		unsigned reg;
+		unsigned partition;
+
+		LiveSegment(SlotIndex s, SlotIndex e, unsigned r, unsigned p)
+			: start(s), end(e), reg(r), partition(p) {}
+
+		bool operator<(const LiveSegment &other) const
+		{
+			if(partition != other.partition)
+				return partition < other.partition;
+			if(start != other.start)
+				return start < other.start;
+			if(end != other.end)
+				return end < other.end;
+			return reg < other.reg;
+		}
+	};
+
+	//A contiguous slice of the sorted segments and the edges found from it. Each
+	//segment is only tested against the segments after it that start before it
+	//ends, so every overlapping pair is found once, by the shard of its earlier
+	//segment, and no shard needs the state of another one.
+	struct EdgeShard
+	{
+		const vector<LiveSegment> *Segments;
+		unsigned Begin, End;
+		vector<pair<unsigned, unsigned> > Edges;
+	};
+
+	void *collectEdges(void *arg)
+	{
+		EdgeShard *shard = static_cast<EdgeShard*>(arg);
+		const vector<LiveSegment> &segs = *shard->Segments;
+		for(unsigned i = shard->Begin; i != shard->End; i++)
+		{
+			for(unsigned j = i + 1; j != segs.size(); j++)
+			{
+				if(segs[j].partition != segs[i].partition || !(segs[j].start < segs[i].end))
+					break;
+				if(segs[j].reg != segs[i].reg)
+					shard->Edges.push_back(make_pair(segs[i].reg, segs[j].reg));
+			}
+		}
+		return 0;
+	}
+
+	//what the statistics file reports for each function
+	struct AllocationStats
+	{
+		unsigned VirtRegs, Edges, Rounds, Spills, Splits;
+		double BuildTime, SimplifyTime, SelectTime, SpillTime, RewriteTime;
+
+		AllocationStats() { clear(); }
+
+		void clear()
+		{
+			VirtRegs = Edges = Rounds = Spills = Splits = 0;
+			BuildTime = SimplifyTime = SelectTime = SpillTime = RewriteTime = 0;
+		}
+	};
+
+	//Everything the allocator knows about the function being allocated. The pass owns
+	//one context, so nothing is shared between two instances of the pass.
+	struct AllocationContext
+	{
+		ColorGraph InterferenceGraph;
+		RegOccupancy Occupancy;
+		DegreeBuckets Buckets;
+		vector<unsigned> SelectStack;
+		vector<int> Degree;
+		BitVector OnStack;
+		BitVector Colored;
+
+		//spill choice: cost of each node, the queue of candidates and the nodes that
+		//were pushed as potential spills
+		vector<float> SpillCost;
+		priority_queue<SpillCandidate, vector<SpillCandidate>, greater<SpillCandidate> > SpillCandidates;
+		BitVector PotentialSpill;
+
+		//virtual registers spilled so far and the pieces made by splitting, which are
+		//not split again. The registers spilled or split in the current round and the
+		//intervals that replace them are kept for an incremental update of the graph.
+		BitVector Spilled;
+		BitVector SplitPieces;
+		vector<unsigned> ReplacedThisRound;
+		vector<LiveInterval*> NewIntervals;
+
+		//splits around an invariant loop, credited once the function is allocated if
+		//a piece outside the loop was spilled and no piece inside it was. Spilled also
+		//marks intervals that splitting emptied, SpilledIntervals only the registers
+		//spillInterval really spilled.
+		BitVector SpilledIntervals;
+		struct LoopSplit
+		{
+			vector<unsigned> Outer, Inner;
+			uint64_t SpillsAvoided;
+		};
+		vector<LoopSplit> LoopSplits;
+
+		//coalescing state: the moves, the moves of each node, and the nodes merged
+		//into each representative
+		vector<CopyMove> Moves;
+		vector<vector<unsigned> > MoveList;
+		vector<unsigned> WorklistMoves;
+		vector<unsigned> FreezeWorklist;
+		vector<unsigned> MoveNodes;
+		unsigned MoveNodesCursor;
+		vector<unsigned> Alias;
+		vector<vector<unsigned> > Members;
+		BitVector CoalescedNodes;
+
+		//allocation order of each register class as a set of registers, and for each
+		//physical register the registers it overlaps, itself included
+		map<const TargetRegisterClass*, BitVector> ClassOrder;
+		vector<BitVector> OverlapMask;
+		BitVector Forbidden;
+
+		//register class partitions: classes whose allocation orders share a register
+		//or an alias compete for the same registers and end up in one partition
+		map<const TargetRegisterClass*, unsigned> ClassPartition;
+		unsigned NumPartitions;
+		vector<unsigned> Partition;
+		vector<vector<unsigned> > PartitionNodes;
+
+		//the splits (true) and spills (false) made so far, in order, for the cache
+		vector<pair<bool, unsigned> > Actions;
+
+		AllocationContext() : MoveNodesCursor(0), NumPartitions(0) {}
+
+		//drops all per function state; the containers are indexed by virtual register
+		//numbers, which the next function uses again
+		void clear()
+		{
+			InterferenceGraph.clear();
+			Occupancy.clear();
+			Buckets.init(0);
+			SelectStack.clear();
+			Degree.clear();
+			OnStack.clear();
+			Colored.clear();
+			SpillCost.clear();
+			SpillCandidates = priority_queue<SpillCandidate, vector<SpillCandidate>,
+					greater<SpillCandidate> >();
+			PotentialSpill.clear();
+			Spilled.clear();
+			SpilledIntervals.clear();
+			SplitPieces.clear();
+			ReplacedThisRound.clear();
+			NewIntervals.clear();
+			LoopSplits.clear();
+			Moves.clear();
+			MoveList.clear();
+			WorklistMoves.clear();
+			FreezeWorklist.clear();
+			MoveNodes.clear();
+			MoveNodesCursor = 0;
+			Alias.clear();
+			Members.clear();
+			CoalescedNodes.clear();
+			ClassOrder.clear();
+			OverlapMask.clear();
+			Forbidden.clear();
+			ClassPartition.clear();
+			NumPartitions = 0;
+			Partition.clear();
+			PartitionNodes.clear();
+			Actions.clear();
+		}
+	};
 
 	class RegAllocGraphColoring : public MachineFunctionPass 
 	{
@@ -60,9 +644,21 @@ namespace {
 
 			VirtRegMap *vrm;
 			LiveStacks *lss;
-			int k;
+			bool RebuildGraph;
+			AllocationContext Ctx;
 
-			RegAllocGraphColoring() : MachineFunctionPass(ID)
+			//how the current function was allocated
+			enum AllocationTier { ColoringTier, LinearScanTier, CachedTier };
+			AllocationTier Tier;
+			//a cache entry was partly replayed before it failed a check
+			bool CacheMiss;
+			AllocationStats Stats;
+
+			//Chaitin-Briggs simplify and select, or Chow-Hennessy priority coloring
+			bool PriorityColoring;
+
+			RegAllocGraphColoring(bool priority = false)
+				: MachineFunctionPass(ID), PriorityColoring(priority)
 			{
 				initializeSlotIndexesPass(*PassRegistry::getPassRegistry());
 				initializeLiveIntervalsPass(*PassRegistry::getPassRegistry());
@@ -76,7 +672,8 @@ namespace {
 
 			virtual const char *getPassName() const
 			{
-				return "Graph Coloring Register Allocator";
+				return PriorityColoring ? "Priority Graph Coloring Register Allocator"
+					: "Graph Coloring Register Allocator";
 			}
 			virtual void getAnalysisUsage(AnalysisUsage &AU) const 
 			{
@@ -97,264 +694,1487 @@ namespace {
 
 			bool runOnMachineFunction(MachineFunction &Fn);
 			void buildInterferenceGraph();
-			bool compatible_class(MachineFunction & mf, unsigned v_reg, unsigned p_reg);
-			bool aliasCheck(unsigned preg, unsigned vreg);
-			set<unsigned> getSetofPotentialRegs(TargetRegisterClass trc,unsigned v_reg);
-			unsigned GetReg(set<unsigned> PotentialRegs, unsigned v_reg);
+			void buildInterferenceGraphSweep();
+			void buildInterferenceGraphParallel(const vector<LiveSegment> &Segments);
+			void addInterference(unsigned v_reg1, unsigned v_reg2);
+			int addNodes();
+			void computeClassPartitions();
+			unsigned partitionOf(unsigned v_reg);
+			bool needsColor(unsigned reg);
+			void growNodes();
+			void addIntervalNode(LiveInterval *li);
+			bool allocateIncremental();
+			unsigned countCoalescedCopies();
+			void buildOccupancy();
+			bool isFree(unsigned p_reg, const LiveInterval &li);
+			const BitVector &classOrder(const TargetRegisterClass *trc);
+			bool regFits(unsigned p_reg, unsigned v_reg);
+			unsigned GetReg(const BitVector &PotentialRegs, unsigned v_reg);
+			unsigned findColor(unsigned v_reg);
+			void assignColor(unsigned v_reg, unsigned p_reg);
 			bool colorNode(unsigned v_reg);
 			bool allocateRegisters();
+			bool allocatePriority();
+			void simplify(const vector<unsigned> &nodes);
+			unsigned numColors(unsigned node);
+			bool isActive(unsigned node);
+			void removeNode(unsigned node);
+			void decrementDegree(unsigned node);
+			void collectMoves();
+			bool moveRelated(unsigned node);
+			void addWorkList(unsigned node);
+			void enableMoves(unsigned node);
+			unsigned getAlias(unsigned node);
+			bool briggs(unsigned u, unsigned v);
+			bool george(unsigned u, unsigned v);
+			void combine(unsigned u, unsigned v);
+			void coalesce();
+			void freezeMoves(unsigned node);
+			bool freeze();
+			bool freezeAny();
+			void computeSpillCosts();
+			float spillCost(unsigned node);
+			void pushSpillCandidate(unsigned node);
+			unsigned selectSpill();
 			bool SpillIt(unsigned v_reg);
+			bool spillInterval(unsigned v_reg);
+			unsigned countVirtRegs();
+			void allocateLinearScan();
+			bool SplitIt(unsigned v_reg);
+			bool isInvariantIn(unsigned v_reg, const MachineLoop *loop);
+			const MachineLoop *findInvariantLoop(unsigned v_reg);
+			void creditLoopSplits();
+			bool isRematerializable(unsigned v_reg);
 			void addStackInterval(const LiveInterval*,MachineRegisterInfo *);
+			void colorStackSlots();
 			void dumpPass();
+			void writeStats();
+			const char *tierName();
+			uint64_t hashFunction();
+			std::string cachePath(uint64_t hash);
+			bool replayCache(const std::string &path);
+			void writeCache(const std::string &path);
 	};
 	char RegAllocGraphColoring::ID = 0;
 }
 
+//Adds an edge between two virtual registers
+void RegAllocGraphColoring::addInterference(unsigned v_reg1, unsigned v_reg2)
+{
+	unsigned n1 = TargetRegisterInfo::virtReg2Index(v_reg1);
+	unsigned n2 = TargetRegisterInfo::virtReg2Index(v_reg2);
+	//registers of different partitions never compete for a color
+	if(Ctx.Partition[n1] != Ctx.Partition[n2])
+		return;
+	if(Ctx.InterferenceGraph.addEdge(n1, n2))
+	{
+		Ctx.Degree[n1]++;
+		Ctx.Degree[n2]++;
+	}
+}
+
+//Adds a node for every virtual register that has a live interval
+int RegAllocGraphColoring::addNodes()
+{
+	int num=0;
+	unsigned numVirtRegs = mri->getNumVirtRegs();
+	Ctx.InterferenceGraph.init(numVirtRegs);
+	Ctx.Degree.assign(numVirtRegs, 0);
+	Ctx.OnStack.reset();
+	Ctx.OnStack.resize(numVirtRegs);
+	Ctx.Colored.reset();
+	Ctx.Colored.resize(numVirtRegs);
+	Ctx.CoalescedNodes.reset();
+	Ctx.CoalescedNodes.resize(numVirtRegs);
+	Ctx.PotentialSpill.reset();
+	Ctx.PotentialSpill.resize(numVirtRegs);
+	Ctx.Alias.assign(numVirtRegs, 0);
+	Ctx.Members.assign(numVirtRegs, vector<unsigned>());
+	Ctx.MoveList.assign(numVirtRegs, vector<unsigned>());
+	Ctx.Moves.clear();
+	Ctx.WorklistMoves.clear();
+	Ctx.FreezeWorklist.clear();
+	Ctx.MoveNodes.clear();
+	Ctx.MoveNodesCursor = 0;
+	Ctx.Spilled.resize(numVirtRegs);
+	Ctx.Partition.assign(numVirtRegs, 0);
+	for (LiveIntervals::iterator ii = LI->begin(); ii != LI->end(); ii++) 
+	{
+		if(!needsColor(ii->first))
+			continue;
+		num++;
+		unsigned node = TargetRegisterInfo::virtReg2Index(ii->first);
+		Ctx.InterferenceGraph.addNode(node);
+		Ctx.Partition[node] = partitionOf(ii->first);
+	}
+	return num;
+}
+
+//Groups the register classes used by the function into partitions. Two classes are
+//in the same partition if a register of one allocation order is, or aliases, a
+//register of the other one, so registers of different partitions can never take
+//each other's colors and need no edges between them.
+void RegAllocGraphColoring::computeClassPartitions()
+{
+	Ctx.ClassPartition.clear();
+	vector<const TargetRegisterClass*> Classes;
+	set<const TargetRegisterClass*> Seen;
+	for(unsigned i = 0, e = mri->getNumVirtRegs(); i != e; i++)
+	{
+		const TargetRegisterClass *trc = mri->getRegClass(TargetRegisterInfo::index2VirtReg(i));
+		if(Seen.insert(trc).second)
+			Classes.push_back(trc);
+	}
+
+	//registers each class may touch, aliases included
+	vector<BitVector> Touched(Classes.size(), BitVector(TRI->getNumRegs()));
+	for(unsigned c = 0; c != Classes.size(); c++)
+	{
+		for(TargetRegisterClass::iterator ii = Classes[c]->allocation_order_begin(*MF),
+				ee = Classes[c]->allocation_order_end(*MF); ii != ee; ii++)
+		{
+			for(const unsigned *overlap = TRI->getOverlaps(*ii); *overlap; overlap++)
+				Touched[c].set(*overlap);
+		}
+	}
+
+	EquivalenceClasses<unsigned> Groups;
+	for(unsigned c = 0; c != Classes.size(); c++)
+	{
+		Groups.insert(c);
+		for(unsigned d = 0; d != c; d++)
+		{
+			BitVector common = Touched[c];
+			common &= Touched[d];
+			if(common.any())
+				Groups.unionSets(c, d);
+		}
+	}
+
+	//number the partitions in order of their first class
+	map<unsigned, unsigned> Numbering;
+	for(unsigned c = 0; c != Classes.size(); c++)
+	{
+		unsigned leader = Groups.getLeaderValue(c);
+		if(!Numbering.count(leader))
+		{
+			unsigned next = Numbering.size();
+			Numbering[leader] = next;
+		}
+		Ctx.ClassPartition[Classes[c]] = Numbering[leader];
+	}
+	Ctx.NumPartitions = Numbering.size();
+	DEBUG(dbgs()<<"\nRegister class partitions: "<<Ctx.NumPartitions);
+}
+
+unsigned RegAllocGraphColoring::partitionOf(unsigned v_reg)
+{
+	return Ctx.ClassPartition[mri->getRegClass(v_reg)];
+}
+
+//virtual registers that were spilled have no uses left and are not colored again
+bool RegAllocGraphColoring::needsColor(unsigned reg)
+{
+	if(TRI->isPhysicalRegister(reg))
+		return false;
+	return !testNodeBit(Ctx.Spilled, TargetRegisterInfo::virtReg2Index(reg));
+}
+
+//resizes the per node state after new virtual registers were created
+void RegAllocGraphColoring::growNodes()
+{
+	unsigned numVirtRegs = mri->getNumVirtRegs();
+	Ctx.InterferenceGraph.grow(numVirtRegs);
+	Ctx.Degree.resize(numVirtRegs, 0);
+	Ctx.OnStack.resize(numVirtRegs);
+	Ctx.Colored.resize(numVirtRegs);
+	Ctx.CoalescedNodes.resize(numVirtRegs);
+	Ctx.PotentialSpill.resize(numVirtRegs);
+	Ctx.Spilled.resize(numVirtRegs);
+	Ctx.Alias.resize(numVirtRegs, 0);
+	Ctx.Members.resize(numVirtRegs);
+	Ctx.MoveList.resize(numVirtRegs);
+	Ctx.SpillCost.resize(numVirtRegs, 0);
+	Ctx.Partition.resize(numVirtRegs, 0);
+}
+
+//adds a node for an interval created by a spill, with an edge to every node it
+//overlaps
+void RegAllocGraphColoring::addIntervalNode(LiveInterval *li)
+{
+	unsigned node = TargetRegisterInfo::virtReg2Index(li->reg);
+	if(li->empty())
+		return;
+	Ctx.Partition[node] = partitionOf(li->reg);
+	SlotIndex begin = li->beginIndex(), end = li->endIndex();
+	const vector<unsigned> &nodes = Ctx.InterferenceGraph.nodes();
+	for(vector<unsigned>::const_iterator ii = nodes.begin(); ii != nodes.end(); ii++)
+	{
+		if(Ctx.Partition[*ii] != Ctx.Partition[node])
+			continue;
+		const LiveInterval &other = LI->getInterval(TargetRegisterInfo::index2VirtReg(*ii));
+		if(other.empty() || !(other.beginIndex() < end) || !(begin < other.endIndex()))
+			continue;
+		if(other.overlaps(*li))
+			addInterference(li->reg, other.reg);
+	}
+	Ctx.InterferenceGraph.addNode(node);
+}
+
 //Builds Interference Graph
 void RegAllocGraphColoring::buildInterferenceGraph()
 {
-	int num=0;
-	for (LiveIntervals::iterator ii = LI->begin(); ii != LI->end(); ii++) 
+	if(SweepInterference)
+	{
+		buildInterferenceGraphSweep();
+		return;
+	}
+	int num = addNodes();
+	for (LiveIntervals::iterator ii = LI->begin(); ii != LI->end(); ii++) 
+	{
+		if(!needsColor(ii->first))
+			continue;
+		const LiveInterval *li = ii->second;
+		for (LiveIntervals::iterator jj = LI->begin(); jj != LI->end(); jj++) 
+		{
+			const LiveInterval *li2 = jj->second;
+			if(jj->first == ii->first)
+				continue;
+			if(!needsColor(jj->first))
+				continue;
+			if(partitionOf(ii->first) != partitionOf(jj->first))
+				continue;
+			if (li->overlaps(*li2)) 
+				addInterference(ii->first, jj->first);
+		}	
+	}
+	Ctx.InterferenceGraph.finalize();
+	DEBUG(dbgs()<<"\nVirtual registers: "<<num);
+}
+
+//Builds the graph of a large function from the sorted segments on several threads.
+//The segments are cut into one shard per thread, every thread collects the edges of
+//its shard on its own, and the edges are added shard by shard afterwards, so the
+//graph is the same as the one built by a single thread.
+void RegAllocGraphColoring::buildInterferenceGraphParallel(const vector<LiveSegment> &Segments)
+{
+	unsigned numShards = std::min<unsigned>(ParallelBuildThreads, Segments.size());
+	vector<EdgeShard> Shards(numShards);
+	for(unsigned t = 0; t != numShards; t++)
+	{
+		Shards[t].Segments = &Segments;
+		Shards[t].Begin = (uint64_t)Segments.size() * t / numShards;
+		Shards[t].End = (uint64_t)Segments.size() * (t + 1) / numShards;
+	}
+
+#ifdef COLOR_PTHREADS
+	//the first shard is done by this thread, and any shard whose thread could not be
+	//started as well
+	vector<pthread_t> Threads(numShards);
+	vector<bool> Started(numShards, false);
+	for(unsigned t = 1; t < numShards; t++)
+		Started[t] = pthread_create(&Threads[t], 0, collectEdges, &Shards[t]) == 0;
+	for(unsigned t = 0; t < numShards; t++)
+	{
+		if(!Started[t])
+			collectEdges(&Shards[t]);
+	}
+	for(unsigned t = 1; t < numShards; t++)
+	{
+		if(Started[t])
+			pthread_join(Threads[t], 0);
+	}
+#else
+	for(unsigned t = 0; t != numShards; t++)
+		collectEdges(&Shards[t]);
+#endif
+
+	for(unsigned t = 0; t != numShards; t++)
+	{
+		vector<pair<unsigned, unsigned> > &edges = Shards[t].Edges;
+		for(vector<pair<unsigned, unsigned> >::iterator ei = edges.begin(); ei != edges.end(); ei++)
+			addInterference(ei->first, ei->second);
+	}
+	Ctx.InterferenceGraph.finalize();
+}
+
+//Builds the same graph as the pairwise loop, but from the live segments sorted by
+//partition and start index. A segment can only overlap the segments that are still open when it
+//starts, so the active set is the only thing each new segment is tested against.
+void RegAllocGraphColoring::buildInterferenceGraphSweep()
+{
+	int num = addNodes();
+	vector<LiveSegment> Segments;
+	for (LiveIntervals::iterator ii = LI->begin(); ii != LI->end(); ii++) 
+	{
+		if(!needsColor(ii->first))
+			continue;
+		const LiveInterval *li = ii->second;
+		unsigned partition = partitionOf(ii->first);
+		for(LiveInterval::const_iterator ri = li->begin(); ri != li->end(); ri++)
+			Segments.push_back(LiveSegment(ri->start, ri->end, ii->first, partition));
+	}
+	sort(Segments.begin(), Segments.end());
+	if(num >= (int)ParallelBuildThreshold && ParallelBuildThreads > 1)
+	{
+		buildInterferenceGraphParallel(Segments);
+		DEBUG(dbgs()<<"\nVirtual registers: "<<num);
+		return;
+	}
+
+	//each partition is swept on its own
+	vector<LiveSegment> Active;
+	for(vector<LiveSegment>::iterator si = Segments.begin(); si != Segments.end(); si++)
+	{
+		//expire segments that ended before this one starts
+		unsigned live = 0;
+		for(unsigned a = 0; a != Active.size(); a++)
+		{
+			if(si->partition == Active[a].partition && si->start < Active[a].end)
+				Active[live++] = Active[a];
+		}
+		Active.resize(live, *si);
+
+		//every segment still open overlaps the new one
+		for(vector<LiveSegment>::iterator ai = Active.begin(); ai != Active.end(); ai++)
+		{
+			if(ai->reg != si->reg)
+				addInterference(si->reg, ai->reg);
+		}
+		Active.push_back(*si);
+	}
+	Ctx.InterferenceGraph.finalize();
+	DEBUG(dbgs()<<"\nVirtual registers: "<<num);
+}
+
+//fills the occupancy of every physical register from the fixed intervals, before
+//any virtual register is colored
+void RegAllocGraphColoring::buildOccupancy()
+{
+	Ctx.Occupancy.init(TRI->getNumRegs());
+	for (LiveIntervals::iterator ii = LI->begin(); ii != LI->end(); ii++) 
+	{
+		if(TargetRegisterInfo::isPhysicalRegister(ii->first))
+			Ctx.Occupancy.add(ii->first, *ii->second);
+	}
+}
+
+//checks if neither the physical register nor one of its aliases is occupied
+//anywhere the interval is live
+bool RegAllocGraphColoring::isFree(unsigned p_reg, const LiveInterval &li)
+{
+	for(const unsigned *overlap = TRI->getOverlaps(p_reg); *overlap; overlap++)
+	{
+		if(Ctx.Occupancy.overlaps(*overlap, li))
+			return false;
+	}
+	return true;
+}
+
+//returns the allocation order of the class as a set of registers. The sets, and the
+//overlap masks of their registers, are made once per function.
+const BitVector &RegAllocGraphColoring::classOrder(const TargetRegisterClass *trc)
+{
+	map<const TargetRegisterClass*, BitVector>::iterator ii = Ctx.ClassOrder.find(trc);
+	if(ii != Ctx.ClassOrder.end())
+		return ii->second;
+	unsigned numRegs = TRI->getNumRegs();
+	if(Ctx.OverlapMask.size() != numRegs)
+		Ctx.OverlapMask.assign(numRegs, BitVector());
+	BitVector &order = Ctx.ClassOrder[trc];
+	order.resize(numRegs);
+	for(TargetRegisterClass::iterator ri = trc->allocation_order_begin(*MF),
+			re = trc->allocation_order_end(*MF); ri != re; ri++)
+	{
+		order.set(*ri);
+		if(!Ctx.OverlapMask[*ri].empty())
+			continue;
+		Ctx.OverlapMask[*ri].resize(numRegs);
+		for(const unsigned *overlap = TRI->getOverlaps(*ri); *overlap; overlap++)
+			Ctx.OverlapMask[*ri].set(*overlap);
+	}
+	return order;
+}
+
+//checks if the physical register can hold the virtual register and every register
+//coalesced into it
+bool RegAllocGraphColoring::regFits(unsigned p_reg, unsigned v_reg)
+{
+	if(!LI->hasInterval(v_reg))
+		return false;
+	if(!isFree(p_reg, LI->getInterval(v_reg)))
+		return false;
+	const vector<unsigned> &members = Ctx.Members[TargetRegisterInfo::virtReg2Index(v_reg)];
+	for(vector<unsigned>::const_iterator ii = members.begin(); ii != members.end(); ii++)
+	{
+		unsigned member = TargetRegisterInfo::index2VirtReg(*ii);
+		if(LI->hasInterval(member) && !isFree(p_reg, LI->getInterval(member)))
+			return false;
+	}
+	return true;
+}
+
+//returns the physical register to which the virtual register must be mapped. If there is no
+//physical register available this function returns 0. The allocation preference left by
+//the coalescer is tried first.
+unsigned RegAllocGraphColoring::GetReg(const BitVector &PotentialRegs, unsigned v_reg)
+{
+	unsigned pref = vrm->getRegAllocPref(v_reg);
+	if(pref != 0 && pref < PotentialRegs.size() && PotentialRegs.test(pref) && regFits(pref, v_reg))
+		return pref;
+	for(int reg = PotentialRegs.find_first(); reg != -1; reg = PotentialRegs.find_next(reg))
+	{
+		if(regFits(reg, v_reg))
+			return reg;
+	}
+	return 0;
+}
+
+// Adds a stack interval if the given live interval has been
+// spilled. Used to support stack slot coloring.
+void RegAllocGraphColoring::addStackInterval(const LiveInterval *spilled,
+                                    MachineRegisterInfo* mri)
+{
+	int stackSlot = vrm->getStackSlot(spilled->reg);
+
+	if (stackSlot == VirtRegMap::NO_STACK_SLOT)
+	{
+		return;
+	}
+
+	const TargetRegisterClass *RC = mri->getRegClass(spilled->reg);
+	LiveInterval &stackInterval = lss->getOrCreateInterval(stackSlot, RC);
+
+	VNInfo *vni;
+	if (stackInterval.getNumValNums() != 0)
+	{
+		vni = stackInterval.getValNumInfo(0);
+	} 
+	else
+ 	{
+		vni = stackInterval.getNextValue(
+		SlotIndex(), 0, lss->getVNInfoAllocator());
+	}
+
+	LiveInterval &rhsInterval = LI->getInterval(spilled->reg);
+	stackInterval.MergeRangesInAsValue(rhsInterval, vni);
+}
+
+//Stack slot coloring: two spill slots of the same size whose stack intervals do not
+//overlap can share their memory. An interference graph is built over the spill
+//slots, each slot takes the first earlier slot none of whose members it
+//interferes with, and the instructions are rewritten to use that slot.
+void RegAllocGraphColoring::colorStackSlots()
+{
+	MachineFrameInfo *mfi = MF->getFrameInfo();
+	vector<int> Slots;
+	for(LiveStacks::iterator ii = lss->begin(); ii != lss->end(); ii++)
+	{
+		int fi = ii->first;
+		if(fi >= 0 && mfi->isSpillSlotObjectIndex(fi) && !mfi->isDeadObjectIndex(fi))
+			Slots.push_back(fi);
+	}
+	if(Slots.size() < 2)
+		return;
+	sort(Slots.begin(), Slots.end());
+
+	unsigned numSlots = Slots.size();
+	vector<BitVector> Interferes(numSlots, BitVector(numSlots));
+	for(unsigned a = 0; a != numSlots; a++)
+	{
+		for(unsigned b = 0; b != a; b++)
+		{
+			if(lss->getInterval(Slots[a]).overlaps(lss->getInterval(Slots[b])))
+			{
+				Interferes[a].set(b);
+				Interferes[b].set(a);
+			}
+		}
+	}
+
+	//slots of each color, the first one being the slot the others are merged into
+	vector<vector<unsigned> > Colors;
+	map<int, int> SlotMapping;
+	for(unsigned a = 0; a != numSlots; a++)
+	{
+		unsigned color = 0;
+		for(; color != Colors.size(); color++)
+		{
+			unsigned first = Colors[color].front();
+			if(mfi->getObjectSize(Slots[first]) != mfi->getObjectSize(Slots[a]))
+				continue;
+			bool fits = true;
+			for(vector<unsigned>::iterator mi = Colors[color].begin(); mi != Colors[color].end(); mi++)
+			{
+				if(Interferes[a].test(*mi))
+				{
+					fits = false;
+					break;
+				}
+			}
+			if(fits)
+				break;
+		}
+		if(color == Colors.size())
+			Colors.push_back(vector<unsigned>());
+		Colors[color].push_back(a);
+		if(Colors[color].size() > 1)
+			SlotMapping[Slots[a]] = Slots[Colors[color].front()];
+	}
+	if(SlotMapping.empty())
+		return;
+
+	//rewrite the frame index operands and the memory operands that refer to them
+	for(MachineFunction::iterator mbb = MF->begin(); mbb != MF->end(); mbb++)
+	{
+		for(MachineBasicBlock::iterator mi = mbb->begin(); mi != mbb->end(); mi++)
+		{
+			for(unsigned i = 0; i != mi->getNumOperands(); i++)
+			{
+				MachineOperand &mo = mi->getOperand(i);
+				if(!mo.isFI())
+					continue;
+				map<int, int>::iterator si = SlotMapping.find(mo.getIndex());
+				if(si == SlotMapping.end())
+					continue;
+				mo.setIndex(si->second);
+			}
+			for(MachineInstr::mmo_iterator mmo = mi->memoperands_begin();
+					mmo != mi->memoperands_end(); mmo++)
+			{
+				for(map<int, int>::iterator si = SlotMapping.begin(); si != SlotMapping.end(); si++)
+				{
+					if((*mmo)->getValue() == PseudoSourceValue::getFixedStack(si->first))
+					{
+						(*mmo)->setValue(PseudoSourceValue::getFixedStack(si->second));
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	for(map<int, int>::iterator si = SlotMapping.begin(); si != SlotMapping.end(); si++)
+	{
+		//the ranges move to the slot that stays; LiveStacks has no way to drop the
+		//interval of the removed slot, so it is emptied for anything still walking it
+		LiveInterval &merged = lss->getInterval(si->second);
+		LiveInterval &removed = lss->getInterval(si->first);
+		merged.MergeRangesInAsValue(removed, merged.getValNumInfo(0));
+		removed.clear();
+		unsigned align = mfi->getObjectAlignment(si->first);
+		if(align > mfi->getObjectAlignment(si->second))
+			mfi->setObjectAlignment(si->second, align);
+		NumSlotsMerged++;
+		NumFrameBytesSaved += mfi->getObjectSize(si->first);
+		DEBUG(dbgs()<<"\nStack slot "<<si->first<<" ---> merged into "<<si->second);
+		mfi->RemoveStackObject(si->first);
+	}
+}
+
+//checks if every definition of the register can be executed again where the value
+//is needed, e.g. constants, frame addresses and loads from the constant pool
+bool RegAllocGraphColoring::isRematerializable(unsigned v_reg)
+{
+	MachineRegisterInfo::def_iterator di = mri->def_begin(v_reg);
+	if(di == mri->def_end())
+		return false;
+	for(; di != mri->def_end(); ++di)
+	{
+		if(!tii->isTriviallyReMaterializable(&*di))
+			return false;
+	}
+	return true;
+}
+
+//checks if the register is live into the loop and never redefined in it, and if the
+//loop has a preheader to reload it in and exit blocks entered only from the loop,
+//so that no exit edge has to be split
+bool RegAllocGraphColoring::isInvariantIn(unsigned v_reg, const MachineLoop *loop)
+{
+	if(!loop->getLoopPreheader())
+		return false;
+	if(!LI->isLiveInToMBB(LI->getInterval(v_reg), loop->getHeader()))
+		return false;
+	for(MachineRegisterInfo::def_iterator di = mri->def_begin(v_reg); di != mri->def_end(); ++di)
+	{
+		if(loop->contains(di->getParent()))
+			return false;
+	}
+	SmallVector<MachineBasicBlock*, 8> exits;
+	loop->getExitBlocks(exits);
+	for(unsigned i = 0; i != exits.size(); i++)
+	{
+		for(MachineBasicBlock::pred_iterator pi = exits[i]->pred_begin(); pi != exits[i]->pred_end(); pi++)
+		{
+			if(!loop->contains(*pi))
+				return false;
+		}
+	}
+	return true;
+}
+
+//returns the deepest loop with a use of the register that the register is invariant
+//in, or 0 if there is none
+const MachineLoop *RegAllocGraphColoring::findInvariantLoop(unsigned v_reg)
+{
+	const MachineLoop *best = 0;
+	for(MachineRegisterInfo::use_nodbg_iterator ui = mri->use_nodbg_begin(v_reg);
+			ui != mri->use_nodbg_end(); ++ui)
+	{
+		for(const MachineLoop *loop = loopInfo->getLoopFor(ui->getParent()); loop;
+				loop = loop->getParentLoop())
+		{
+			if(best && loop->getLoopDepth() <= best->getLoopDepth())
+				break;
+			if(isInvariantIn(v_reg, loop))
+			{
+				best = loop;
+				break;
+			}
+		}
+	}
+	return best;
+}
+
+//Splits the interval around the deepest loop it is used but not redefined in, or
+//around the loop with the most uses, or else gives each block with several uses an
+//interval of its own, so that only the pieces that cannot get a register are
+//spilled later. The pieces become new nodes and are not split again.
+bool RegAllocGraphColoring::SplitIt(unsigned v_reg)
+{
+	if(testNodeBit(Ctx.SplitPieces, TargetRegisterInfo::virtReg2Index(v_reg)))
+		return false;
+	LiveInterval &li = LI->getInterval(v_reg);
+	if(!li.isSpillable())
+		return false;
+	//recomputing the value at each use is cheaper than the copies a split adds
+	if(isRematerializable(v_reg))
+		return false;
+
+	std::vector<LiveInterval*> pieces;
+	SplitAnalysis splitAnalysis(*MF, *LI, *loopInfo);
+	splitAnalysis.analyze(&li);
+	//-color-loop-spills works without -color-split: only the split around the
+	//invariant loop is tried then
+	const MachineLoop *invariantLoop = LoopAwareSpills ? findInvariantLoop(v_reg) : 0;
+	if(invariantLoop)
+	{
+		//the part outside the loop is what gets spilled, so the value is reloaded
+		//once in the preheader instead of at every use in the loop. The split copies
+		//the value back into the outer interval at each exit, and spilling that
+		//interval stores it there, so the exits cost a store each.
+		unsigned usesInLoop = 0;
+		for(MachineRegisterInfo::use_nodbg_iterator ui = mri->use_nodbg_begin(v_reg);
+				ui != mri->use_nodbg_end(); ++ui)
+		{
+			if(invariantLoop->contains(ui->getParent()))
+				usesInLoop++;
+		}
+		SplitEditor(splitAnalysis, *LI, *vrm, pieces).splitAroundLoop(invariantLoop);
+		if(!pieces.empty())
+		{
+			//a block at depth d is assumed to run 10^d times
+			uint64_t inner = 1, cost;
+			for(unsigned d = 0; d != invariantLoop->getLoopDepth(); d++)
+				inner *= 10;
+			//the reload in the preheader and the store in every exit block
+			cost = inner / 10;
+			SmallVector<MachineBasicBlock*, 8> exits;
+			invariantLoop->getExitBlocks(exits);
+			for(unsigned e = 0; e != exits.size(); e++)
+			{
+				uint64_t weight = 1;
+				for(unsigned d = 0; d != loopInfo->getLoopDepth(exits[e]); d++)
+					weight *= 10;
+				cost += weight;
+			}
+			AllocationContext::LoopSplit split;
+			split.SpillsAvoided = usesInLoop * inner > cost ? usesInLoop * inner - cost : 0;
+			vector<unsigned> regs;
+			for(std::vector<LiveInterval*>::iterator ii = pieces.begin(); ii != pieces.end(); ii++)
+				regs.push_back((*ii)->reg);
+			if(!li.empty())
+				regs.push_back(v_reg);
+			for(vector<unsigned>::iterator ri = regs.begin(); ri != regs.end(); ri++)
+			{
+				bool inLoop = false;
+				for(MachineRegisterInfo::reg_nodbg_iterator oi = mri->reg_nodbg_begin(*ri);
+						oi != mri->reg_nodbg_end() && !inLoop; ++oi)
+					inLoop = invariantLoop->contains(oi->getParent());
+				(inLoop ? split.Inner : split.Outer).push_back(*ri);
+			}
+			Ctx.LoopSplits.push_back(split);
+		}
+	}
+	else if(!SplitBeforeSpill)
+		return false;
+	else if(const MachineLoop *loop = splitAnalysis.getBestSplitLoop())
+		SplitEditor(splitAnalysis, *LI, *vrm, pieces).splitAroundLoop(loop);
+	else
+	{
+		SplitAnalysis::BlockPtrSet blocks;
+		if(splitAnalysis.getMultiUseBlocks(blocks))
+			SplitEditor(splitAnalysis, *LI, *vrm, pieces).splitSingleBlocks(blocks);
+	}
+	if(pieces.empty())
+		return false;
+
+	NumSplits++;
+	Stats.Splits++;
+	Ctx.Actions.push_back(make_pair(true, v_reg));
+	DEBUG(dbgs()<<"\nVreg : "<<v_reg<<" ---> Split into "<<pieces.size()<<" intervals");
+	for(std::vector<LiveInterval*>::iterator ii = pieces.begin(); ii != pieces.end(); ii++)
+		setNodeBit(Ctx.SplitPieces, TargetRegisterInfo::virtReg2Index((*ii)->reg));
+	Ctx.ReplacedThisRound.push_back(v_reg);
+	Ctx.NewIntervals.insert(Ctx.NewIntervals.end(), pieces.begin(), pieces.end());
+	//whatever is left of the original interval gets a new node as well
+	if(li.empty())
+		setNodeBit(Ctx.Spilled, TargetRegisterInfo::virtReg2Index(v_reg));
+	else
+		Ctx.NewIntervals.push_back(&li);
+	return true;
+}
+
+//counts the loop splits that paid off: the value was spilled outside the loop and
+//stayed in a register inside it
+void RegAllocGraphColoring::creditLoopSplits()
+{
+	for(vector<AllocationContext::LoopSplit>::iterator si = Ctx.LoopSplits.begin(); si != Ctx.LoopSplits.end(); si++)
+	{
+		bool outerSpilled = false, innerSpilled = false;
+		for(vector<unsigned>::iterator ri = si->Outer.begin(); ri != si->Outer.end(); ri++)
+			outerSpilled |= testNodeBit(Ctx.SpilledIntervals, TargetRegisterInfo::virtReg2Index(*ri));
+		for(vector<unsigned>::iterator ri = si->Inner.begin(); ri != si->Inner.end(); ri++)
+			innerSpilled |= testNodeBit(Ctx.SpilledIntervals, TargetRegisterInfo::virtReg2Index(*ri));
+		if(outerSpilled && !innerSpilled)
+		{
+			NumLoopSplits++;
+			NumDynamicSpillsAvoided += si->SpillsAvoided;
+		}
+	}
+	Ctx.LoopSplits.clear();
+}
+
+//Spills virtual register
+bool RegAllocGraphColoring::SpillIt(unsigned v_reg)
+{
+	PhaseTimer timer("Spill", TimerGroup, Stats.SpillTime);
+	if((SplitBeforeSpill || LoopAwareSpills) && SplitIt(v_reg))
+		return false;
+	return spillInterval(v_reg);
+}
+
+//spills the whole interval to its stack slot, returns false if new intervals were
+//made for the reloads and stores
+bool RegAllocGraphColoring::spillInterval(unsigned v_reg)
+{
+	const LiveInterval* spillInterval = &LI->getInterval(v_reg);
+	SmallVector<LiveInterval*, 8> spillIs;
+	Stats.Spills++;
+	Ctx.Actions.push_back(make_pair(false, v_reg));
+	rmf->rememberUseDefs(spillInterval);
+	std::vector<LiveInterval*> newSpills =
+		LI->addIntervalsForSpills(*spillInterval, spillIs, loopInfo, *vrm);
+	//a new interval that addIntervalsForSpills marked as rematerialized re-executes
+	//the definition where the others reload from the stack slot
+	unsigned remats = 0;
+	for(std::vector<LiveInterval*>::iterator ni = newSpills.begin(); ni != newSpills.end(); ni++)
+		if(vrm->isReMaterialized((*ni)->reg))
+			remats++;
+	if(remats)
+	{
+		NumRemats++;
+		NumReloadsAvoided += remats;
+	}
+	addStackInterval(spillInterval, mri);
+	rmf->rememberSpills(spillInterval, newSpills);
+	setNodeBit(Ctx.Spilled, TargetRegisterInfo::virtReg2Index(v_reg));
+	setNodeBit(Ctx.SpilledIntervals, TargetRegisterInfo::virtReg2Index(v_reg));
+	Ctx.ReplacedThisRound.push_back(v_reg);
+	Ctx.NewIntervals.insert(Ctx.NewIntervals.end(), newSpills.begin(), newSpills.end());
+	return newSpills.empty();
+}
+
+//returns a physical register the virtual register can be colored with, or 0 if
+//there is none left. The registers taken by colored neighbours and their aliases
+//are collected in a bit mask and masked out of the class's allocation order.
+unsigned RegAllocGraphColoring::findColor(unsigned v_reg)
+{
+	const BitVector &order = classOrder(MF->getRegInfo().getRegClass(v_reg));
+	Ctx.Forbidden.reset();
+	Ctx.Forbidden.resize(order.size());
+	unsigned node = TargetRegisterInfo::virtReg2Index(v_reg);
+	const vector<unsigned> &adj = Ctx.InterferenceGraph.adjacent(node);
+	for(vector<unsigned>::const_iterator ii = adj.begin( ); ii != adj.end( ); ii++)
+	{
+		if(!Ctx.Colored.test( *ii ))
+			continue;
+		unsigned p_reg = vrm->getPhys(TargetRegisterInfo::index2VirtReg(*ii));
+		if(!Ctx.OverlapMask[p_reg].empty())
+			Ctx.Forbidden |= Ctx.OverlapMask[p_reg];
+		else
+			Ctx.Forbidden.set(p_reg);
+	}
+	BitVector PotentialRegs(Ctx.Forbidden);
+	PotentialRegs.flip();
+	PotentialRegs &= order;
+	//There are no Potential Physical Registers Available
+	if(PotentialRegs.none( ))
+		return 0;
+	//Get compatible Physical Register
+	return GetReg(PotentialRegs,v_reg);
+}
+
+//assigns physical to virtual register, and to the registers coalesced into it
+void RegAllocGraphColoring::assignColor(unsigned v_reg, unsigned p_reg)
+{
+	unsigned node = TargetRegisterInfo::virtReg2Index(v_reg);
+	vrm->assignVirt2Phys( v_reg , p_reg );
+	DEBUG(dbgs()<<"\nVreg : "<<v_reg<<" ---> Preg :"<<TRI->getName(p_reg));
+	Ctx.Colored.set(node);
+	Ctx.Occupancy.add(p_reg, LI->getInterval(v_reg));
+	if(Ctx.PotentialSpill.test(node))
+		NumOptimistic++;
+	for(vector<unsigned>::iterator ii = Ctx.Members[node].begin(); ii != Ctx.Members[node].end(); ii++)
+	{
+		unsigned member = TargetRegisterInfo::index2VirtReg(*ii);
+		vrm->assignVirt2Phys(member, p_reg);
+		Ctx.Colored.set(*ii);
+		if(LI->hasInterval(member))
+			Ctx.Occupancy.add(p_reg, LI->getInterval(member));
+	}
+}
+
+//colors a virtual register, or spills it if no physical register is left
+bool RegAllocGraphColoring::colorNode(unsigned v_reg)
+{
+	bool notspilled = true;
+	DEBUG(dbgs()<<"\nColoring Register  : "<<v_reg);
+	unsigned node = TargetRegisterInfo::virtReg2Index(v_reg);
+	unsigned p_reg = findColor(v_reg);
+	if(!p_reg)
+	{
+		notspilled = SpillIt(v_reg);
+		DEBUG(dbgs()<<"\nVreg : "<<v_reg<<" ---> Spilled");
+	}
+	else
+		assignColor(v_reg, p_reg);
+	//the registers coalesced into a spilled one are left without a color and need
+	//another round
+	if(!Ctx.Colored.test(node) && !Ctx.Members[node].empty())
+		notspilled = false;
+	return notspilled;
+}
+
+//number of registers a node of this class can be colored with
+unsigned RegAllocGraphColoring::numColors(unsigned node)
+{
+	return classOrder(mri->getRegClass(TargetRegisterInfo::index2VirtReg(node))).count();
+}
+
+//a node is active while it is neither on the select stack nor coalesced away
+bool RegAllocGraphColoring::isActive(unsigned node)
+{
+	return !Ctx.OnStack.test(node) && !Ctx.CoalescedNodes.test(node);
+}
+
+//pushes a node on the select stack and deletes it from the graph
+void RegAllocGraphColoring::removeNode(unsigned node)
+{
+	DEBUG(dbgs()<<"\nRegister selected to push on stack = "<<TargetRegisterInfo::index2VirtReg(node));
+	Ctx.Buckets.remove(node);
+	Ctx.OnStack.set(node);
+	Ctx.SelectStack.push_back(node);
+	const vector<unsigned> &adj = Ctx.InterferenceGraph.adjacent(node);
+	for(vector<unsigned>::const_iterator ii = adj.begin(); ii != adj.end(); ii++)
+	{
+		if(isActive(*ii))
+			decrementDegree(*ii);
+	}
+}
+
+void RegAllocGraphColoring::decrementDegree(unsigned node)
+{
+	int degree = Ctx.Degree[node]--;
+	Ctx.Buckets.update(node, Ctx.Degree[node]);
+	//the node just became insignificant, moves that were blocked on it or on its
+	//neighbours may pass the conservative tests now
+	if(degree == (int)numColors(node))
+	{
+		enableMoves(node);
+		const vector<unsigned> &adj = Ctx.InterferenceGraph.adjacent(node);
+		for(vector<unsigned>::const_iterator ii = adj.begin(); ii != adj.end(); ii++)
+		{
+			if(isActive(*ii))
+				enableMoves(*ii);
+		}
+		if(moveRelated(node))
+			Ctx.FreezeWorklist.push_back(node);
+	}
+}
+
+//finds the copies left between virtual registers of the same class that do not
+//interfere
+void RegAllocGraphColoring::collectMoves()
+{
+	for (MachineFunction::iterator mbbItr = MF->begin(), mbbEnd = MF->end();
+			mbbItr != mbbEnd; ++mbbItr) 
+	{
+		for (MachineBasicBlock::iterator miItr = mbbItr->begin(), miEnd = mbbItr->end();
+				miItr != miEnd; ++miItr) 
+		{
+			MachineInstr &mi = *miItr;
+			if(!mi.isCopy())
+				continue;
+			const MachineOperand &dst = mi.getOperand(0);
+			const MachineOperand &src = mi.getOperand(1);
+			if(dst.getSubReg() || src.getSubReg())
+				continue;
+			if(!TRI->isVirtualRegister(dst.getReg()) || !TRI->isVirtualRegister(src.getReg()))
+				continue;
+			if(dst.getReg() == src.getReg() ||
+					mri->getRegClass(dst.getReg()) != mri->getRegClass(src.getReg()))
+				continue;
+			unsigned d = TargetRegisterInfo::virtReg2Index(dst.getReg());
+			unsigned s = TargetRegisterInfo::virtReg2Index(src.getReg());
+			if(!Ctx.InterferenceGraph.hasNode(d) || !Ctx.InterferenceGraph.hasNode(s) ||
+					Ctx.InterferenceGraph.interferes(d, s))
+				continue;
+			Ctx.MoveList[d].push_back(Ctx.Moves.size());
+			Ctx.MoveList[s].push_back(Ctx.Moves.size());
+			Ctx.Moves.push_back(CopyMove(d, s));
+		}
+	}
+}
+
+//true if the node still has a move that may be coalesced
+bool RegAllocGraphColoring::moveRelated(unsigned node)
+{
+	for(vector<unsigned>::iterator ii = Ctx.MoveList[node].begin(); ii != Ctx.MoveList[node].end(); ii++)
+	{
+		if(Ctx.Moves[*ii].State == CopyMove::Worklist || Ctx.Moves[*ii].State == CopyMove::Active)
+			return true;
+	}
+	return false;
+}
+
+//a node that is no longer move related goes back to the simplify buckets
+void RegAllocGraphColoring::addWorkList(unsigned node)
+{
+	if(!isActive(node) || Ctx.Buckets.contains(node) || moveRelated(node))
+		return;
+	Ctx.Buckets.insert(node, Ctx.Degree[node]);
+	pushSpillCandidate(node);
+}
+
+void RegAllocGraphColoring::enableMoves(unsigned node)
+{
+	for(vector<unsigned>::iterator ii = Ctx.MoveList[node].begin(); ii != Ctx.MoveList[node].end(); ii++)
 	{
-		
-		if(TRI->isPhysicalRegister(ii->first))
-			continue;
-		num++;
-		OnStack[ii->first] = false;    
-		InterferenceGraph[ii->first].insert(0);
-		const LiveInterval *li = ii->second;
-		for (LiveIntervals::iterator jj = LI->begin(); jj != LI->end(); jj++) 
+		if(Ctx.Moves[*ii].State == CopyMove::Active)
 		{
-			const LiveInterval *li2 = jj->second;
-			if(jj->first == ii->first)
-				continue;
-			if(TRI->isPhysicalRegister(jj->first))
-				continue;
-			if (li->overlaps(*li2)) 
-			{
-				if(!InterferenceGraph[ii->first].count(jj->first))
-				{
-					InterferenceGraph[ii->first].insert(jj->first);
-					Degree[ii->first]++;
-				}
-				if(!InterferenceGraph[jj->first].count(ii->first))
-				{
-					InterferenceGraph[jj->first].insert(ii->first);
-					Degree[jj->first]++;
-				}
-			}
-		}	
+			Ctx.Moves[*ii].State = CopyMove::Worklist;
+			Ctx.WorklistMoves.push_back(*ii);
+		}
 	}
-	errs( )<<"\nVirtual registers: "<<num;
 }
 
-//This function is used to check the compatibility of virtual register with the physical reg.
-//For Eg. floating point values must be stored in floating point registers.
-bool RegAllocGraphColoring::compatible_class(MachineFunction & mf, unsigned v_reg, unsigned p_reg)
+unsigned RegAllocGraphColoring::getAlias(unsigned node)
 {
-	assert(MRegisterInfo::isPhysicalRegister(p_reg) &&
-			"Target register must be physical");
-	const TargetRegisterClass *trc = mf.getRegInfo().getRegClass(v_reg);
+	while(Ctx.CoalescedNodes.test(node))
+		node = Ctx.Alias[node];
+	return node;
+}
+
+//Briggs test: the merged node has fewer significant neighbours than colors
+bool RegAllocGraphColoring::briggs(unsigned u, unsigned v)
+{
+	unsigned significant = 0;
+	const vector<unsigned> &adjU = Ctx.InterferenceGraph.adjacent(u);
+	for(vector<unsigned>::const_iterator ii = adjU.begin(); ii != adjU.end(); ii++)
+	{
+		if(isActive(*ii) && Ctx.Degree[*ii] >= (int)numColors(*ii))
+			significant++;
+	}
+	const vector<unsigned> &adjV = Ctx.InterferenceGraph.adjacent(v);
+	for(vector<unsigned>::const_iterator ii = adjV.begin(); ii != adjV.end(); ii++)
+	{
+		//common neighbours were already counted
+		if(isActive(*ii) && !Ctx.InterferenceGraph.interferes(*ii, u) &&
+				Ctx.Degree[*ii] >= (int)numColors(*ii))
+			significant++;
+	}
+	return significant < numColors(u);
+}
 
-	return trc->contains(p_reg);
+//George test: every neighbour of v is insignificant or already interferes with u
+bool RegAllocGraphColoring::george(unsigned u, unsigned v)
+{
+	const vector<unsigned> &adj = Ctx.InterferenceGraph.adjacent(v);
+	for(vector<unsigned>::const_iterator ii = adj.begin(); ii != adj.end(); ii++)
+	{
+		if(isActive(*ii) && Ctx.Degree[*ii] >= (int)numColors(*ii) &&
+				!Ctx.InterferenceGraph.interferes(*ii, u))
+			return false;
+	}
+	return true;
 }
 
-//check if aliases are empty
-bool RegAllocGraphColoring::aliasCheck(unsigned preg, unsigned vreg)
+//merges node v into node u
+void RegAllocGraphColoring::combine(unsigned u, unsigned v)
 {
-	const unsigned *aliasItr = TRI->getAliasSet(preg);
-	while(*aliasItr != 0)
+	Ctx.CoalescedNodes.set(v);
+	Ctx.Alias[v] = u;
+	Ctx.MoveList[u].insert(Ctx.MoveList[u].end(), Ctx.MoveList[v].begin(), Ctx.MoveList[v].end());
+	Ctx.Members[u].push_back(v);
+	Ctx.Members[u].insert(Ctx.Members[u].end(), Ctx.Members[v].begin(), Ctx.Members[v].end());
+	Ctx.SpillCost[u] += Ctx.SpillCost[v];
+	enableMoves(v);
+	const vector<unsigned> &adj = Ctx.InterferenceGraph.adjacent(v);
+	for(vector<unsigned>::const_iterator ii = adj.begin(); ii != adj.end(); ii++)
 	{
-		for(set<unsigned>::iterator ii = InterferenceGraph[vreg].begin( );
-				ii != InterferenceGraph[vreg].end( ); ii++)
+		if(!isActive(*ii))
+			continue;
+		if(Ctx.InterferenceGraph.addEdge(*ii, u))
 		{
-			if(Colored.count( *ii ) && vrm->getPhys(*ii) == *aliasItr)
-				return false;
+			Ctx.Degree[*ii]++;
+			Ctx.Degree[u]++;
+			Ctx.Buckets.update(*ii, Ctx.Degree[*ii]);
+			//a higher degree makes the neighbour a cheaper spill than its queued entry says
+			pushSpillCandidate(*ii);
 		}
-		aliasItr++;
+		decrementDegree(*ii);
 	}
-	return true;
 }
 
-//return the set of potential register for a virtual register
-set<unsigned> RegAllocGraphColoring::getSetofPotentialRegs(TargetRegisterClass trc,unsigned v_reg)
+//takes one move off the worklist and tries to coalesce it
+void RegAllocGraphColoring::coalesce()
 {
-	TargetRegisterClass::iterator ii;
-	TargetRegisterClass::iterator ee;
-	unsigned p_reg = vrm->getRegAllocPref(v_reg);
-	if(p_reg != 0)
+	unsigned m = Ctx.WorklistMoves.back();
+	Ctx.WorklistMoves.pop_back();
+	if(Ctx.Moves[m].State != CopyMove::Worklist)
+		return;
+	unsigned u = getAlias(Ctx.Moves[m].Dst);
+	unsigned v = getAlias(Ctx.Moves[m].Src);
+	//the lower index survives, so the outcome does not depend on copy direction
+	if(v < u)
+		std::swap(u, v);
+	if(u == v)
+	{
+		Ctx.Moves[m].State = CopyMove::Coalesced;
+		addWorkList(u);
+	}
+	else if(Ctx.InterferenceGraph.interferes(u, v))
+	{
+		Ctx.Moves[m].State = CopyMove::Constrained;
+		addWorkList(u);
+		addWorkList(v);
+	}
+	else if(george(u, v) || briggs(u, v))
 	{
-		PhysicalRegisters.insert( p_reg );
+		Ctx.Moves[m].State = CopyMove::Coalesced;
+		combine(u, v);
+		addWorkList(u);
 	}
 	else
 	{
-		ii = trc.allocation_order_begin(*MF);
-		ee = trc.allocation_order_end(*MF);
-		while(ii != ee)
-		{
-			PhysicalRegisters.insert( *ii );
-			ii++;
-		}
+		Ctx.Moves[m].State = CopyMove::Active;
 	}
-	k = PhysicalRegisters.size();
-	return PhysicalRegisters;
 }
 
-//returns the physical register to which the virtual register must be mapped. If there is no
-//physical register available this function returns 0.
-unsigned RegAllocGraphColoring::GetReg(set<unsigned> PotentialRegs, unsigned v_reg)
+//gives up on the moves of a node so that it can be simplified
+void RegAllocGraphColoring::freezeMoves(unsigned node)
 {
-	for(set<unsigned>::iterator ii = PotentialRegs.begin( ); ii != PotentialRegs.end( ); ii++)
+	for(vector<unsigned>::iterator ii = Ctx.MoveList[node].begin(); ii != Ctx.MoveList[node].end(); ii++)
 	{
-		if(!LI->hasInterval(*ii) || !LI->hasInterval(v_reg))
-		{
+		CopyMove &move = Ctx.Moves[*ii];
+		if(move.State != CopyMove::Worklist && move.State != CopyMove::Active)
 			continue;
-		}
-		LiveInterval li1 = LI->getInterval(*ii);
-		LiveInterval li2 = LI->getInterval(v_reg);
-		if( aliasCheck(*ii,v_reg) && !li1.overlaps(li2)&& compatible_class(*MF,v_reg,*ii))
-		{
-			return *ii;
-		}
+		move.State = CopyMove::Frozen;
+		unsigned other = getAlias(move.Dst);
+		if(other == node)
+			other = getAlias(move.Src);
+		addWorkList(other);
 	}
-	return 0;
 }
 
-// Adds a stack interval if the given live interval has been
-// spilled. Used to support stack slot coloring.
-void RegAllocGraphColoring::addStackInterval(const LiveInterval *spilled,
-                                    MachineRegisterInfo* mri)
+//freezes a low degree move related node, returns false if there is none
+bool RegAllocGraphColoring::freeze()
 {
-	int stackSlot = vrm->getStackSlot(spilled->reg);
+	while(!Ctx.FreezeWorklist.empty())
+	{
+		unsigned node = Ctx.FreezeWorklist.back();
+		Ctx.FreezeWorklist.pop_back();
+		if(!isActive(node) || Ctx.Buckets.contains(node) || Ctx.Degree[node] >= (int)numColors(node))
+			continue;
+		freezeMoves(node);
+		addWorkList(node);
+		return true;
+	}
+	return false;
+}
 
-	if (stackSlot == VirtRegMap::NO_STACK_SLOT)
+//only significant move related nodes are left, freeze one of them so that it can
+//be pushed as a potential spill
+bool RegAllocGraphColoring::freezeAny()
+{
+	for(; Ctx.MoveNodesCursor != Ctx.MoveNodes.size(); Ctx.MoveNodesCursor++)
 	{
-		return;
+		unsigned node = Ctx.MoveNodes[Ctx.MoveNodesCursor];
+		if(!isActive(node) || Ctx.Buckets.contains(node))
+			continue;
+		freezeMoves(node);
+		addWorkList(node);
+		return true;
 	}
+	return false;
+}
 
-	const TargetRegisterClass *RC = mri->getRegClass(spilled->reg);
-	LiveInterval &stackInterval = lss->getOrCreateInterval(stackSlot, RC);
+//Spill cost of every node: each use and def is weighted by the depth of the loop it
+//sits in, and the sum is divided by the length of the interval, so short intervals
+//that are used a lot inside loops are the most expensive to spill. Intervals made
+//by earlier spills cannot be spilled again.
+void RegAllocGraphColoring::computeSpillCosts()
+{
+	Ctx.SpillCost.assign(Ctx.Degree.size(), 0);
+	const vector<unsigned> &nodes = Ctx.InterferenceGraph.nodes();
+	for(vector<unsigned>::const_iterator ii = nodes.begin(); ii != nodes.end(); ii++)
+		Ctx.SpillCost[*ii] = spillCost(*ii);
+}
 
-	VNInfo *vni;
-	if (stackInterval.getNumValNums() != 0)
+float RegAllocGraphColoring::spillCost(unsigned node)
+{
+	unsigned v_reg = TargetRegisterInfo::index2VirtReg(node);
+	const LiveInterval &li = LI->getInterval(v_reg);
+	if(!li.isSpillable())
+		return HUGE_VALF;
+	float cost = 0;
+	for(MachineRegisterInfo::reg_iterator ri = mri->reg_begin(v_reg), re = mri->reg_end();
+			ri != re; ++ri)
 	{
-		vni = stackInterval.getValNumInfo(0);
-	} 
-	else
- 	{
-		vni = stackInterval.getNextValue(
-		SlotIndex(), 0, lss->getVNInfoAllocator());
+		MachineInstr *mi = &*ri;
+		if(mi->isDebugValue())
+			continue;
+		const MachineOperand &mo = ri.getOperand();
+		unsigned depth = loopInfo->getLoopDepth(mi->getParent());
+		cost += LiveIntervals::getSpillWeight(mo.isDef(), mo.isUse(), depth);
 	}
-
-	LiveInterval &rhsInterval = LI->getInterval(spilled->reg);
-	stackInterval.MergeRangesInAsValue(rhsInterval, vni);
+	//a rematerialized value costs no stack traffic, only the recomputation
+	if(isRematerializable(v_reg))
+		cost *= 0.5F;
+	return cost / (li.getSize() + 1);
 }
 
-//Spills virtual register
-bool RegAllocGraphColoring::SpillIt(unsigned v_reg)
+void RegAllocGraphColoring::pushSpillCandidate(unsigned node)
 {
+	if(!Ctx.Buckets.contains(node))
+		return;
+	int degree = Ctx.Degree[node];
+	float priority = Ctx.SpillCost[node] / (degree > 0 ? degree : 1);
+	Ctx.SpillCandidates.push(SpillCandidate(priority, node, degree));
+}
 
-	const LiveInterval* spillInterval = &LI->getInterval(v_reg);
-	SmallVector<LiveInterval*, 8> spillIs;
-	rmf->rememberUseDefs(spillInterval);
-	std::vector<LiveInterval*> newSpills =
-		LI->addIntervalsForSpills(*spillInterval, spillIs, loopInfo, *vrm);
-	addStackInterval(spillInterval, mri);
-	rmf->rememberSpills(spillInterval, newSpills);
-	return newSpills.empty();
+//picks the potential spill with the lowest cost per degree. Queue entries are
+//updated lazily: entries of nodes that left the buckets are dropped, and entries
+//whose degree is out of date are queued again with the current one.
+unsigned RegAllocGraphColoring::selectSpill()
+{
+	while(true)
+	{
+		SpillCandidate candidate = Ctx.SpillCandidates.top();
+		Ctx.SpillCandidates.pop();
+		if(!Ctx.Buckets.contains(candidate.Node))
+			continue;
+		if(candidate.Degree != Ctx.Degree[candidate.Node])
+		{
+			pushSpillCandidate(candidate.Node);
+			continue;
+		}
+		return candidate.Node;
+	}
 }
 
-//assigns physical to virtual register
-bool RegAllocGraphColoring::colorNode(unsigned v_reg)
+//removes nodes from the graph until it is empty, pushing them on the select stack.
+//Insignificant nodes that are not move related are simplified first, in order of
+//their degree. Then copies are coalesced, move related nodes are frozen, and at
+//last the node with the lowest spill cost per degree is pushed as a potential
+//spill. Potential spills are only spilled if select finds no color left for them.
+//The nodes are those of one partition, and there is at least one.
+void RegAllocGraphColoring::simplify(const vector<unsigned> &nodes)
 {
-	bool notspilled = true;
-	errs()<<"\nColoring Register  : "<<v_reg;
-	unsigned p_reg = 0;
-	const TargetRegisterClass *trc = MF->getRegInfo().getRegClass(v_reg);
-	set<unsigned> PotentialRegs = getSetofPotentialRegs(*trc,v_reg);
-	for(set<unsigned>::iterator ii = InterferenceGraph[v_reg].begin( ) ;
-			ii != InterferenceGraph[v_reg].end( ); ii++)
-	{
-		if(Colored.count( *ii ))
-			PotentialRegs.erase(vrm->getPhys(*ii));	
-		if(PotentialRegs.empty( ))
+	Ctx.SpillCandidates = priority_queue<SpillCandidate, vector<SpillCandidate>,
+			greater<SpillCandidate> >();
+	Ctx.SelectStack.clear();
+	Ctx.SelectStack.reserve(nodes.size());
+	Ctx.WorklistMoves.clear();
+	Ctx.FreezeWorklist.clear();
+	Ctx.MoveNodes.clear();
+	Ctx.MoveNodesCursor = 0;
+	for(vector<unsigned>::const_iterator ii = nodes.begin(); ii != nodes.end(); ii++)
+	{
+		if(moveRelated(*ii))
+		{
+			Ctx.MoveNodes.push_back(*ii);
+			if(Ctx.Degree[*ii] < (int)numColors(*ii))
+				Ctx.FreezeWorklist.push_back(*ii);
+		}
+		else
+		{
+			Ctx.Buckets.insert(*ii, Ctx.Degree[*ii]);
+			pushSpillCandidate(*ii);
+		}
+	}
+	//moves only connect registers of the same class
+	unsigned partition = Ctx.Partition[nodes.front()];
+	for(unsigned m = Ctx.Moves.size(); m != 0; m--)
+	{
+		if(Ctx.Partition[Ctx.Moves[m - 1].Dst] == partition)
+			Ctx.WorklistMoves.push_back(m - 1);
+	}
+
+	while(true)
+	{
+		if(!Ctx.Buckets.empty() && Ctx.Degree[Ctx.Buckets.min()] < (int)numColors(Ctx.Buckets.min()))
+			removeNode(Ctx.Buckets.min());
+		else if(!Ctx.WorklistMoves.empty())
+			coalesce();
+		else if(freeze())
+			continue;
+		else if(!Ctx.Buckets.empty())
+		{
+			unsigned node = selectSpill();
+			Ctx.PotentialSpill.set(node);
+			removeNode(node);
+		}
+		else if(!freezeAny())
 			break;
+	}
+}
 
+//Updates the graph of the previous round instead of building it again. The spilled
+//and split nodes are deleted, the intervals that replace them are added with edges to the
+//nodes they overlap, and every node that lost or never had a color is colored with
+//the colors of the other nodes left as they are. Returns false if another round is
+//needed; RebuildGraph is set if that round has to start from scratch.
+bool RegAllocGraphColoring::allocateIncremental()
+{
+	vector<unsigned> Pending;
+	growNodes();
+	for(vector<unsigned>::iterator ii = Ctx.ReplacedThisRound.begin(); ii != Ctx.ReplacedThisRound.end(); ii++)
+	{
+		unsigned node = TargetRegisterInfo::virtReg2Index(*ii);
+		//the registers coalesced into the replaced one get their own nodes back
+		for(vector<unsigned>::iterator mi = Ctx.Members[node].begin(); mi != Ctx.Members[node].end(); mi++)
+		{
+			Ctx.CoalescedNodes.reset(*mi);
+			Pending.push_back(*mi);
+		}
+		Ctx.Members[node].clear();
+		Ctx.InterferenceGraph.removeNode(node);
 	}
-	//There are no Potential Physical Registers Available
-	if(PotentialRegs.empty( ))
+	for(vector<LiveInterval*>::iterator ii = Ctx.NewIntervals.begin(); ii != Ctx.NewIntervals.end(); ii++)
 	{
-		notspilled = SpillIt(v_reg);
-		errs( )<<"\nVreg : "<<v_reg<<" ---> Spilled";
+		addIntervalNode(*ii);
+		unsigned node = TargetRegisterInfo::virtReg2Index((*ii)->reg);
+		if(Ctx.InterferenceGraph.hasNode(node))
+			Pending.push_back(node);
 	}
-	else
+	Ctx.ReplacedThisRound.clear();
+	Ctx.NewIntervals.clear();
+	DEBUG(dbgs()<<"\nIncremental update: "<<Pending.size()<<" nodes to color");
+
+	//most expensive spills first
+	vector<pair<float, unsigned> > Order;
+	for(vector<unsigned>::iterator ii = Pending.begin(); ii != Pending.end(); ii++)
+	{
+		Ctx.SpillCost[*ii] = spillCost(*ii);
+		Order.push_back(make_pair(-Ctx.SpillCost[*ii], *ii));
+	}
+	sort(Order.begin(), Order.end());
+
+	bool round = true;
+	for(vector<pair<float, unsigned> >::iterator ii = Order.begin(); ii != Order.end(); ii++)
 	{
-		//Get compatible Physical Register
-		p_reg = GetReg(PotentialRegs,v_reg);
-		assert(p_reg!=0 && "Assigning 0 reg");
-		//if no such register found due to interfernce with p_reg
-		if(!p_reg)
+		unsigned v_reg = TargetRegisterInfo::index2VirtReg(ii->second);
+		unsigned p_reg = findColor(v_reg);
+		if(p_reg)
+			assignColor(v_reg, p_reg);
+		else if(Ctx.SpillCost[ii->second] == HUGE_VALF)
 		{
-			notspilled = SpillIt(v_reg);
-			errs( )<<"\nVreg : "<<v_reg<<" ---> Spilled";
+			//an interval made by a spill cannot be spilled again, other nodes have to
+			//give way to it
+			RebuildGraph = true;
+			return false;
 		}
 		else
-		{
-			//assigning virtual to physical register
-			vrm->assignVirt2Phys( v_reg , p_reg );
-			errs( )<<"\nVreg : "<<v_reg<<" ---> Preg :"<<TRI->getName(p_reg);
-			Colored.insert(v_reg);
-		}
+			round = SpillIt(v_reg) && round;
 	}
-	return notspilled;
+	return round;
+}
+
+//counts the copies whose two registers ended up in the same physical register
+unsigned RegAllocGraphColoring::countCoalescedCopies()
+{
+	unsigned count = 0;
+	for(vector<CopyMove>::iterator ii = Ctx.Moves.begin(); ii != Ctx.Moves.end(); ii++)
+	{
+		if(ii->State != CopyMove::Coalesced)
+			continue;
+		unsigned dst = TargetRegisterInfo::index2VirtReg(ii->Dst);
+		unsigned src = TargetRegisterInfo::index2VirtReg(ii->Src);
+		if(vrm->hasPhys(dst) && vrm->hasPhys(src) && vrm->getPhys(dst) == vrm->getPhys(src))
+			count++;
+	}
+	return count;
 }
 
 //This is the main graph coloring algorithm
 bool RegAllocGraphColoring::allocateRegisters()
 {
-	bool round;
-	unsigned min = 0;
-	//find virtual register with minimum degree
-	for(map<unsigned, set<unsigned> >::iterator ii = InterferenceGraph.begin(); ii != InterferenceGraph.end(); ii++)
+	bool round = true;
+	computeSpillCosts();
+	if(CoalesceCopies)
+		collectMoves();
+
+	//partitions share no edges and no registers, each one is simplified and
+	//colored on its own
+	Ctx.PartitionNodes.assign(Ctx.NumPartitions, vector<unsigned>());
+	const vector<unsigned> &nodes = Ctx.InterferenceGraph.nodes();
+	for(vector<unsigned>::const_iterator ii = nodes.begin(); ii != nodes.end(); ii++)
+		Ctx.PartitionNodes[Ctx.Partition[*ii]].push_back(*ii);
+	Ctx.Buckets.init(Ctx.Degree.size());
+
+	for(unsigned p = 0; p != Ctx.PartitionNodes.size(); p++)
 	{
-		if(!OnStack[ii->first] && (min == 0 || Degree[ii->first] < Degree[min]))
-			min = ii->first;
-	}		
-	//if graph empty
-	if(min == 0)
-		return true;
-	errs()<<"\nRegister selected to push on stack = "<<min;
+		//every vreg of the partition may already be spilled
+		if(Ctx.PartitionNodes[p].empty())
+			continue;
+		{
+			PhaseTimer timer("Simplify", TimerGroup, Stats.SimplifyTime);
+			simplify(Ctx.PartitionNodes[p]);
+		}
 
-	//push register onto stack
-	OnStack[min] = true;
+		//pop and color virtual registers
+		PhaseTimer timer("Select", TimerGroup, Stats.SelectTime, &Stats.SpillTime);
+		while(!Ctx.SelectStack.empty())
+		{
+			unsigned v_reg = TargetRegisterInfo::index2VirtReg(Ctx.SelectStack.back());
+			Ctx.SelectStack.pop_back();
+			round = colorNode(v_reg) && round;
+		}
+	}
+	return round;
+}
 
-	//delete register from graph
-	for(map<unsigned, set<unsigned> >::iterator ii = InterferenceGraph.begin(); ii != InterferenceGraph.end(); ii++)
+//number of virtual registers that still need a color
+unsigned RegAllocGraphColoring::countVirtRegs()
+{
+	unsigned num = 0;
+	for (LiveIntervals::iterator ii = LI->begin(); ii != LI->end(); ii++) 
 	{
-		if(ii->second.count(min))
-			Degree[ii->first]--;
+		if(needsColor(ii->first))
+			num++;
 	}
+	return num;
+}
+
+//Fallback for functions over the compile time budget. The intervals are visited
+//in order of their start, the ones made by spills first, and each gets the first
+//free register of its class or is spilled. A round sorts the n intervals, and each
+//of their r ranges is checked against and added to the occupancy map of a register
+//in O(log n), so a round is O((n + r) log n) for a fixed number of registers. The
+//next round only has to place the short intervals made by the spills.
+void RegAllocGraphColoring::allocateLinearScan()
+{
+	bool done = false;
+	while(!done)
+	{
+		vrm->clearAllVirt();
+		buildOccupancy();
+		Ctx.Members.assign(mri->getNumVirtRegs(), vector<unsigned>());
 
-	//recursive call
-	round = allocateRegisters();
+		vector<pair<pair<bool, SlotIndex>, unsigned> > Order;
+		for (LiveIntervals::iterator ii = LI->begin(); ii != LI->end(); ii++) 
+		{
+			if(!needsColor(ii->first) || ii->second->empty())
+				continue;
+			Order.push_back(make_pair(make_pair(ii->second->isSpillable(),
+					ii->second->beginIndex()), ii->first));
+		}
+		sort(Order.begin(), Order.end());
 
-	//pop and color virtual register
-	return colorNode(min) && round;
+		done = true;
+		bool progress = false;
+		for(unsigned i = 0; i != Order.size(); i++)
+		{
+			unsigned v_reg = Order[i].second;
+			const BitVector &order = classOrder(mri->getRegClass(v_reg));
+			unsigned p_reg = GetReg(order, v_reg);
+			if(p_reg)
+			{
+				vrm->assignVirt2Phys(v_reg, p_reg);
+				Ctx.Occupancy.add(p_reg, LI->getInterval(v_reg));
+			}
+			else if(Order[i].first.first)
+			{
+				DEBUG(dbgs()<<"\nVreg : "<<v_reg<<" ---> Spilled");
+				spillInterval(v_reg);
+				done = false;
+				progress = true;
+			}
+			else
+				done = false;
+		}
+		if(!done && !progress)
+			report_fatal_error("Ran out of registers during register allocation!");
+	}
 }
 
 
+//Priority-based coloring after Chow and Hennessy. The priority of a live range is
+//its spill cost, the loop weighted uses and defs it saves per unit of length.
+//Constrained ranges, with at least as many neighbours as colors, are colored in
+//order of priority; unconstrained ones always find a color and are colored last.
+//A range with no color left is split, or spilled if it cannot be split, and the
+//pieces are colored in the next round.
+bool RegAllocGraphColoring::allocatePriority()
+{
+	bool round = true;
+	computeSpillCosts();
+
+	vector<pair<float, unsigned> > Constrained;
+	vector<unsigned> Unconstrained;
+	const vector<unsigned> &nodes = Ctx.InterferenceGraph.nodes();
+	for(vector<unsigned>::const_iterator ii = nodes.begin(); ii != nodes.end(); ii++)
+	{
+		if(Ctx.Degree[*ii] < (int)numColors(*ii))
+			Unconstrained.push_back(*ii);
+		else
+			Constrained.push_back(make_pair(-Ctx.SpillCost[*ii], *ii));
+	}
+	sort(Constrained.begin(), Constrained.end());
+
+	PhaseTimer timer("Select", TimerGroup, Stats.SelectTime, &Stats.SpillTime);
+	for(vector<pair<float, unsigned> >::iterator ii = Constrained.begin(); ii != Constrained.end(); ii++)
+		round = colorNode(TargetRegisterInfo::index2VirtReg(ii->second)) && round;
+	for(vector<unsigned>::iterator ii = Unconstrained.begin(); ii != Unconstrained.end(); ii++)
+		round = colorNode(TargetRegisterInfo::index2VirtReg(*ii)) && round;
+	return round;
+}
+
 void RegAllocGraphColoring::dumpPass( )
 {
 	for (MachineFunction::iterator mbbItr = MF->begin(), mbbEnd = MF->end();
 			mbbItr != mbbEnd; ++mbbItr) 
 	{
 		MachineBasicBlock &mbb = *mbbItr;
-		errs() << "bb" << mbb.getNumber() << ":\n";
+		dbgs() << "bb" << mbb.getNumber() << ":\n";
 		for (MachineBasicBlock::iterator miItr = mbb.begin(), miEnd = mbb.end();
 				miItr != miEnd; ++miItr) 
 		{
 			MachineInstr &mi = *miItr;
-			errs( )<<mi;
+			dbgs( )<<mi;
 		}
 	}
 }
@@ -362,7 +2182,7 @@ void RegAllocGraphColoring::dumpPass( )
 
 bool RegAllocGraphColoring::runOnMachineFunction(MachineFunction &mf) 
 {
-	errs()<<"\nRunning On function: "<<mf.getFunction()->getName();
+	DEBUG(dbgs()<<"\nRunning On function: "<<mf.getFunction()->getName());
 	MF = &mf;
 	mri = &MF->getRegInfo(); 
 	TM = &MF->getTarget();
@@ -376,44 +2196,310 @@ bool RegAllocGraphColoring::runOnMachineFunction(MachineFunction &mf)
 	loopInfo = &getAnalysis<MachineLoopInfo>();
 
 	bool another_round = false;
+	bool incremental = false;
 	int round = 1;
+	Tier = ColoringTier;
+	Stats.clear();
+	Stats.VirtRegs = mri->getNumVirtRegs();
+	Ctx.clear();
+	computeClassPartitions();
+
+	DEBUG_WITH_TYPE("regalloc-dump", { dbgs()<<"Pass before allocation\n"; dumpPass(); });
 
-	errs()<<"Pass before allocation\n";
-	dumpPass();
+	uint64_t hash = 0;
+	CacheMiss = false;
+	if(!CacheDir.empty())
+	{
+		hash = hashFunction();
+		if(replayCache(cachePath(hash)))
+		{
+			Tier = CachedTier;
+			NumCacheHits++;
+			another_round = true;
+		}
+	}
 
-	do
+	while(!another_round)
 	{
-		errs( )<<"\nRound #"<<round<<'\n';
+		DEBUG(dbgs()<<"\nRound #"<<round<<'\n');
 		round++;
-		vrm->clearAllVirt();
-		buildInterferenceGraph();
-		another_round = allocateRegisters();
-		InterferenceGraph.clear( );
-		Degree.clear( );
-		OnStack.clear( );
-		Colored.clear();
-		Allocatable.clear();
-		PhysicalRegisters.clear();
-		errs( )<<*vrm;
-	} while(!another_round);
+		RebuildGraph = false;
+		if(MaxRounds && (unsigned)round - 1 > MaxRounds)
+			Tier = LinearScanTier;
+		else if(incremental)
+		{
+			PhaseTimer timer("Select", TimerGroup, Stats.SelectTime, &Stats.SpillTime);
+			another_round = allocateIncremental();
+		}
+		else if(MaxVirtRegs && countVirtRegs() > MaxVirtRegs)
+			Tier = LinearScanTier;
+		else
+		{
+			vrm->clearAllVirt();
+			Ctx.ReplacedThisRound.clear();
+			Ctx.NewIntervals.clear();
+			{
+				PhaseTimer timer("Graph build", TimerGroup, Stats.BuildTime);
+				buildOccupancy();
+				buildInterferenceGraph();
+			}
+			Stats.Edges = std::max(Stats.Edges, Ctx.InterferenceGraph.numEdges());
+			if(MaxEdges && Ctx.InterferenceGraph.numEdges() > MaxEdges)
+				Tier = LinearScanTier;
+			else
+				another_round = PriorityColoring ? allocatePriority() : allocateRegisters();
+		}
+		if(Tier == LinearScanTier)
+		{
+			DEBUG(dbgs()<<"\nOver budget, allocating with linear scan");
+			NumLinearScanFallbacks++;
+			allocateLinearScan();
+			another_round = true;
+		}
+		incremental = IncrementalRounds && !RebuildGraph;
+		DEBUG_WITH_TYPE("regalloc-dump", dbgs( )<<*vrm);
+	}
+	if(!CacheDir.empty() && Tier != CachedTier && !CacheMiss)
+		writeCache(cachePath(hash));
+
+	NumCoalesced += countCoalescedCopies();
+	creditLoopSplits();
+	DEBUG(dbgs()<<"\nAllocation tier: "<<tierName());
+	Ctx.clear();
 
 	rmf->renderMachineFunction( "After GraphColoring Register Allocator" , vrm );
 
-	std::auto_ptr<VirtRegRewriter> rewriter(createVirtRegRewriter());
+	{
+		PhaseTimer timer("Rewrite", TimerGroup, Stats.RewriteTime);
+		std::auto_ptr<VirtRegRewriter> rewriter(createVirtRegRewriter());
+
+		//this is used to write the final code.
+		rewriter->runOnMachineFunction(*MF, *vrm, LI);
+		if(ColorStackSlots)
+			colorStackSlots();
+	}
+	Stats.Rounds = round - 1;
+	writeStats();
+
+	DEBUG_WITH_TYPE("regalloc-dump", { dbgs()<<"Pass after allocation\n"; dumpPass(); vrm->dump(); });
+
+	return true;
+}
+
+
+//appends the statistics of the function to the -color-stats-file as one JSON line
+void RegAllocGraphColoring::writeStats()
+{
+	if(StatsFile.empty())
+		return;
+	std::string error;
+	raw_fd_ostream out(StatsFile.c_str(), error, raw_fd_ostream::F_Append);
+	if(!error.empty())
+	{
+		errs()<<"Cannot write allocation statistics to "<<StatsFile<<": "<<error<<'\n';
+		return;
+	}
+	//the name the allocator is selected by with -regalloc, and how it colors
+	out<<"{\"pass\":\""<<(PriorityColoring ? "color-priority" : "color1")<<'"'
+		<<",\"strategy\":\""<<(PriorityColoring ? "priority" : "simplify-select")<<'"'
+		<<",\"function\":";
+	writeJSONString(out, MF->getFunction()->getName());
+	out<<",\"tier\":\""<<tierName()<<'"'
+		<<",\"vregs\":"<<Stats.VirtRegs
+		<<",\"edges\":"<<Stats.Edges
+		<<",\"rounds\":"<<Stats.Rounds
+		<<",\"spills\":"<<Stats.Spills
+		<<",\"splits\":"<<Stats.Splits
+		<<",\"build_seconds\":"<<Stats.BuildTime
+		<<",\"simplify_seconds\":"<<Stats.SimplifyTime
+		<<",\"select_seconds\":"<<Stats.SelectTime
+		<<",\"spill_seconds\":"<<Stats.SpillTime
+		<<",\"rewrite_seconds\":"<<Stats.RewriteTime
+		<<"}\n";
+}
+
+const char *RegAllocGraphColoring::tierName()
+{
+	switch(Tier)
+	{
+		case ColoringTier: return "coloring";
+		case LinearScanTier: return "linear-scan";
+		case CachedTier: return "cached";
+	}
+	return "";
+}
+
+//FNV-1a hash of the function before allocation: the target triple, the options
+//that change the allocation, the class of every virtual register and the printed
+//instructions of every block with its successors
+uint64_t RegAllocGraphColoring::hashFunction()
+{
+	std::string text;
+	raw_string_ostream os(text);
+	os<<MF->getFunction()->getParent()->getTargetTriple()<<'\n'
+		<<(int)PriorityColoring<<(int)SplitBeforeSpill<<(int)LoopAwareSpills<<(int)CoalesceCopies<<(int)IncrementalRounds
+		<<' '<<(unsigned)MaxVirtRegs<<' '<<(unsigned)MaxEdges<<' '<<(unsigned)MaxRounds<<'\n';
+	for(unsigned i = 0, e = mri->getNumVirtRegs(); i != e; i++)
+		os<<mri->getRegClass(TargetRegisterInfo::index2VirtReg(i))->getID()<<' ';
+	for(MachineFunction::iterator mbb = MF->begin(); mbb != MF->end(); mbb++)
+	{
+		os<<"\nbb"<<mbb->getNumber()<<" ->";
+		for(MachineBasicBlock::succ_iterator si = mbb->succ_begin(); si != mbb->succ_end(); si++)
+			os<<' '<<(*si)->getNumber();
+		os<<'\n';
+		for(MachineBasicBlock::iterator mi = mbb->begin(); mi != mbb->end(); mi++)
+			mi->print(os, TM);
+	}
+	os.flush();
+
+	uint64_t hash = 14695981039346656037ULL;
+	for(unsigned i = 0; i != text.size(); i++)
+	{
+		hash ^= (unsigned char)text[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+std::string RegAllocGraphColoring::cachePath(uint64_t hash)
+{
+	return CacheDir + "/" + utohexstr(hash) + ".color";
+}
 
-	//this is used to write the final code.
-	rewriter->runOnMachineFunction(*MF, *vrm, LI);
+//Replays a cache entry: the splits and spills are made again in the same order,
+//which numbers the new registers and stack slots as before, and the stored
+//registers are assigned. The whole entry is read and checked before anything is
+//changed: every register that exists must have the stored class, and every
+//physical register must have the stored name and be in the order of its class. An
+//entry that fails there, e.g. after a hash collision, leaves the function as it
+//was. The checks that can only be made while replaying, on the registers the
+//splits create and on the occupancy, leave the splits and spills made so far in
+//place: the function is then allocated as usual from there, and since that state
+//came from a bad entry the result is not written back to the cache.
+bool RegAllocGraphColoring::replayCache(const std::string &path)
+{
+	std::ifstream in(path.c_str());
+	std::string magic;
+	if(!(in>>magic) || magic != "color1-cache-2")
+		return false;
 
-	errs()<<"Pass after allocation\n";
-	dumpPass();
+	//the splits (true) and spills (false) with the class of their register, and the
+	//assignments
+	vector<pair<pair<bool, unsigned>, unsigned> > Actions;
+	map<unsigned, unsigned> Assignment;
+	std::string kind;
+	bool valid = true;
+	while(valid && in>>kind)
+	{
+		unsigned v_reg, rc;
+		if(!(in>>v_reg>>rc) || !TargetRegisterInfo::isVirtualRegister(v_reg) || rc >= TRI->getNumRegClasses())
+			valid = false;
+		//registers past the last one are made by the splits and spills of the entry
+		else if(TargetRegisterInfo::virtReg2Index(v_reg) < mri->getNumVirtRegs() &&
+				mri->getRegClass(v_reg) != TRI->getRegClass(rc))
+			valid = false;
+		else if(kind == "split" || kind == "spill")
+			Actions.push_back(make_pair(make_pair(kind == "split", v_reg), rc));
+		else if(kind == "assign")
+		{
+			unsigned p_reg;
+			std::string name;
+			valid = in>>p_reg>>name && p_reg < TRI->getNumRegs() && name == TRI->getName(p_reg) &&
+				classOrder(TRI->getRegClass(rc)).test(p_reg) && !Assignment.count(v_reg);
+			Assignment[v_reg] = p_reg;
+		}
+		else
+			valid = false;
+	}
+	for(unsigned a = 0; valid && a != Actions.size(); a++)
+	{
+		unsigned v_reg = Actions[a].first.second;
+		if(TargetRegisterInfo::virtReg2Index(v_reg) < mri->getNumVirtRegs())
+			valid = LI->hasInterval(v_reg) && (Actions[a].first.first || LI->getInterval(v_reg).isSpillable());
+	}
+	if(!valid)
+	{
+		DEBUG(dbgs()<<"\nRejected allocation cache entry "<<path);
+		NumCacheRejected++;
+		return false;
+	}
 
-	vrm->dump( );
+	for(unsigned a = 0; valid && a != Actions.size(); a++)
+	{
+		unsigned v_reg = Actions[a].first.second;
+		valid = TargetRegisterInfo::virtReg2Index(v_reg) < mri->getNumVirtRegs() &&
+			LI->hasInterval(v_reg) && mri->getRegClass(v_reg) == TRI->getRegClass(Actions[a].second);
+		if(!valid)
+			break;
+		if(Actions[a].first.first)
+			valid = SplitIt(v_reg);
+		else if((valid = LI->getInterval(v_reg).isSpillable()))
+			spillInterval(v_reg);
+	}
 
+	if(valid)
+	{
+		vrm->clearAllVirt();
+		buildOccupancy();
+		for (LiveIntervals::iterator ii = LI->begin(); valid && ii != LI->end(); ii++) 
+		{
+			if(!needsColor(ii->first))
+				continue;
+			map<unsigned, unsigned>::iterator ai = Assignment.find(ii->first);
+			valid = ai != Assignment.end() &&
+				classOrder(mri->getRegClass(ii->first)).test(ai->second) &&
+				isFree(ai->second, *ii->second);
+			if(valid)
+			{
+				vrm->assignVirt2Phys(ii->first, ai->second);
+				Ctx.Occupancy.add(ai->second, *ii->second);
+			}
+		}
+	}
+	if(!valid)
+	{
+		DEBUG(dbgs()<<"\nRejected allocation cache entry "<<path<<" after replaying part of it");
+		NumCacheRejected++;
+		CacheMiss = true;
+		vrm->clearAllVirt();
+		return false;
+	}
+	DEBUG(dbgs()<<"\nAllocated from cache entry "<<path);
 	return true;
 }
 
+//stores the splits, the spills and the final assignment of the function. The entry
+//is written under a temporary name and renamed, so a reader never sees half of it.
+void RegAllocGraphColoring::writeCache(const std::string &path)
+{
+	std::string temp = path + ".tmp";
+	std::string error;
+	{
+		raw_fd_ostream out(temp.c_str(), error);
+		if(!error.empty())
+			return;
+		out<<"color1-cache-2\n";
+		for(vector<pair<bool, unsigned> >::iterator ai = Ctx.Actions.begin(); ai != Ctx.Actions.end(); ai++)
+			out<<(ai->first ? "split " : "spill ")<<ai->second<<' '<<mri->getRegClass(ai->second)->getID()<<'\n';
+		for (LiveIntervals::iterator ii = LI->begin(); ii != LI->end(); ii++) 
+		{
+			if(needsColor(ii->first) && vrm->hasPhys(ii->first))
+			{
+				unsigned p_reg = vrm->getPhys(ii->first);
+				out<<"assign "<<ii->first<<' '<<mri->getRegClass(ii->first)->getID()<<' '
+					<<p_reg<<' '<<TRI->getName(p_reg)<<'\n';
+			}
+		}
+	}
+	std::rename(temp.c_str(), path.c_str());
+}
 
 FunctionPass *llvm::createColorRegisterAllocator() 
 {
 	return new RegAllocGraphColoring();
 }
+
+FunctionPass *llvm::createPriorityColorRegisterAllocator() 
+{
+	return new RegAllocGraphColoring(true);
+}
@@ -4,21 +4,214 @@
 #include <llvm/Support/InstIterator.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Instructions.h>
+#include <llvm/IntrinsicInst.h>
+#include <llvm/Operator.h>
 #include <llvm/Analysis/LoopInfo.h>
 #include <llvm/CodeGen/MachineRegisterInfo.h>
 #include "llvm/Transforms/Utils/SSAUpdater.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Transforms/Utils/PromoteMemToReg.h"
 #include "llvm/Analysis/Dominators.h"
+#include "PhaseTimer.h"
+#include <algorithm>
 
 using namespace llvm;
 using namespace std;
 
 STATISTIC(NumLoadsHoisted, "Number of loads hoisted");
 STATISTIC(NumStoresSunk, "Number of stores sunked");
+STATISTIC(NumCallsIgnored, "Number of calls in promoted loops that touch no promoted object");
+STATISTIC(NumObjectsMayAlias, "Number of objects left in memory because of a may-alias access or an unsafe preheader load");
+STATISTIC(NumObjectsClobbered, "Number of objects left in memory because a call touches them");
+STATISTIC(NumExitStoresSkipped, "Number of exit stores skipped because the object is clean there");
+STATISTIC(NumPreheaderLoadsSkipped, "Number of preheader loads skipped because the object is written first");
+
+//the -time-passes group of the phase timers
+static const char *const TimerGroup = "Register Promotion";
+
+static cl::opt<bool>
+DenseDataflow("promote-dense-dataflow",
+		cl::desc("Solve the promotion dataflow over densely numbered blocks and bit vectors"),
+		cl::init(true), cl::Hidden);
+
+static cl::opt<bool>
+UseSSAUpdater("promote-ssa-updater",
+		cl::desc("Rewrite promoted objects with SSAUpdater, placing only the phis that are used"),
+		cl::init(false), cl::Hidden);
+
+static cl::opt<bool>
+DirtyTracking("promote-dirty-tracking",
+		cl::desc("Store promoted objects only at the exits where they may have been written, "
+			"and load them only if they may be read before being written"),
+		cl::init(true), cl::Hidden);
+
+static cl::opt<std::string>
+StatsFile("promote-stats-file",
+		cl::desc("Append one JSON line of promotion statistics per function to this file"),
+		cl::init(""), cl::Hidden);
 
 namespace {
+	//what the statistics file reports for each function
+	struct PromotionStats
+	{
+		unsigned Loops, PromotedLoops, PromotedObjects, LoadsHoisted, StoresSunk;
+		double ScanTime, DataflowTime, RewriteTime;
+
+		PromotionStats() { clear(); }
+
+		void clear()
+		{
+			Loops = PromotedLoops = PromotedObjects = LoadsHoisted = StoresSunk = 0;
+			ScanTime = DataflowTime = RewriteTime = 0;
+		}
+	};
+
+	//Dataflow of the promotion of one loop over dense numbers. The region is the
+	//preheader, the loop blocks in reverse post-order and the exit blocks. Every
+	//definition of a memory object has a bit: the load added to the preheader, each
+	//store in the loop and a phi in each block of the region, and the bits of one
+	//object are contiguous. IN and OUT of every block are bit vectors allocated from
+	//an arena. A block needs a phi for an object when more than one definition of it
+	//reaches the block; the phi then replaces those definitions, like insertPhi does.
+	//Blocks are taken from the worklist in region order, and only the successors of
+	//a block whose OUT changed are put back on it.
+	class PromotionDataflow
+	{
+		BumpPtrAllocator Arena;
+		unsigned Words;
+
+		vector<BasicBlock*> Blocks;
+		DenseMap<BasicBlock*, unsigned> BlockNumber;
+		unsigned NumLoopBlocks;
+
+		vector<Value*> Objects;
+		DenseMap<Value*, unsigned> ObjectNumber;
+		vector<unsigned> DefBegin, NumStores;
+		vector<Value*> DefValue;
+		DenseMap<Instruction*, unsigned> StoreDef;
+
+		vector<uint64_t*> IN, OUT, GEN, KILL;
+		vector<PHINode*> Phis;
+
+		uint64_t *newBits()
+		{
+			uint64_t *bits = Arena.Allocate<uint64_t>(Words);
+			std::fill(bits, bits + Words, 0);
+			return bits;
+		}
+
+		static bool test(const uint64_t *bits, unsigned i)
+		{
+			return (bits[i / 64] >> (i % 64)) & 1;
+		}
+
+		static void set(uint64_t *bits, unsigned i)
+		{
+			bits[i / 64] |= (uint64_t)1 << (i % 64);
+		}
+
+		static void reset(uint64_t *bits, unsigned i)
+		{
+			bits[i / 64] &= ~((uint64_t)1 << (i % 64));
+		}
+
+		//the bits of word w that fall in [begin, end)
+		static uint64_t rangeMask(unsigned w, unsigned begin, unsigned end)
+		{
+			uint64_t mask = ~(uint64_t)0;
+			if(w == begin / 64)
+				mask &= ~(uint64_t)0 << (begin % 64);
+			if(w == (end - 1) / 64 && end % 64)
+				mask &= ((uint64_t)1 << (end % 64)) - 1;
+			return mask;
+		}
+
+		//the definitions of an object span a few words, which are counted, set and
+		//cleared a word at a time
+		static unsigned countRange(const uint64_t *bits, unsigned begin, unsigned end)
+		{
+			unsigned count = 0;
+			for(unsigned w = begin / 64; w <= (end - 1) / 64; w++)
+				count += CountPopulation_64(bits[w] & rangeMask(w, begin, end));
+			return count;
+		}
+
+		static void setRange(uint64_t *bits, unsigned begin, unsigned end)
+		{
+			for(unsigned w = begin / 64; w <= (end - 1) / 64; w++)
+				bits[w] |= rangeMask(w, begin, end);
+		}
+
+		static void resetRange(uint64_t *bits, unsigned begin, unsigned end)
+		{
+			for(unsigned w = begin / 64; w <= (end - 1) / 64; w++)
+				bits[w] &= ~rangeMask(w, begin, end);
+		}
+
+		unsigned phiDef(unsigned block, unsigned object)
+		{
+			return DefBegin[object] + 1 + NumStores[object] + block;
+		}
+
+		void numberBlocks(Loop *L, SmallVectorImpl<BasicBlock*> &exits);
+		void numberDefs(Instruction *preheaderEnd, const set<Instruction*> &stores,
+				const set<Value*> &readFirst, map<Value*, unsigned> &alignment);
+		bool transfer(unsigned block);
+		Value *reachingValue(unsigned block, unsigned object, const uint64_t *bits);
+
+		public:
+			void solve(Loop *L, const set<Value*> &objects, const set<Instruction*> &stores,
+					const set<Value*> &readFirst, map<Value*, unsigned> &alignment);
+			void rewrite(const set<Instruction*> &loads, const set<pair<Value*, BasicBlock*> > &dirtyExits,
+					map<Value*, unsigned> &alignment);
+	};
+
+	//Promotes the loads and stores of one memory object in a loop, like LICM's
+	//LoopPromoter: SSAUpdater places the phis the loads need and no others, and the
+	//value live into each exit block is stored back
+	class ObjectPromoter : public LoadAndStorePromoter
+	{
+		Value *Object;
+		const SmallVectorImpl<BasicBlock*> &ExitBlocks;
+		unsigned Alignment;
+
+		public:
+			ObjectPromoter(Value *object, const SmallVectorImpl<Instruction*> &insts,
+					SSAUpdater &ssa, const SmallVectorImpl<BasicBlock*> &exits, unsigned alignment)
+				: LoadAndStorePromoter(insts, ssa, object->getName()),
+				  Object(object), ExitBlocks(exits), Alignment(alignment) {}
+
+			virtual bool isInstInList(Instruction *I, const SmallVectorImpl<Instruction*> &) const
+			{
+				if(LoadInst *load = dyn_cast<LoadInst>(I))
+					return load->getOperand(0) == Object;
+				return cast<StoreInst>(I)->getOperand(1) == Object;
+			}
+
+			virtual void doExtraRewritesBeforeFinalDeletion() const
+			{
+				for(unsigned i = 0; i != ExitBlocks.size(); i++)
+				{
+					BasicBlock *exit = ExitBlocks[i];
+					Value *value = SSA.GetValueInMiddleOfBlock(exit);
+					StoreInst *st = new StoreInst(value, Object, exit->getFirstNonPHI());
+					st->setAlignment(Alignment);
+				}
+			}
+	};
+
 	struct RegPromotion : public FunctionPass
 	{	
 		static char ID;
@@ -29,8 +222,18 @@ namespace {
 		void promoteAllLoops();
 		void promoteInLoop(Loop *L);
 		bool findLoadsAndStoresAdded(Loop* L);	
+		void rejectClobberedObjects(const vector<Instruction*> &calls, const vector<Value*> &objects,
+				const set<Value*> &stored, set<Value*> &rejected);
+		Value *invariantAddress(Loop *L, Value *address);
+		uint64_t accessSize(Value *address);
+		unsigned accessAlignment(Value *address, unsigned alignment);
+		bool isSafeToLoad(Loop *L, Value *object, const vector<Instruction*> &accesses);
+		bool isInsideGlobal(Value *object);
+		void trackDirtyState(Loop *L);
 		void insertLoads();		
 		void replaceLoadsByCopies(Loop* L);
+		void replaceLoadsByCopiesDense(Loop* L);
+		void promoteWithSSAUpdater(Loop* L);
 		void insertStores();
 		void deleteDeadStores();
 		void deleteDeadLoads();	
@@ -38,6 +241,7 @@ namespace {
 		void computeOUT(BasicBlock*);
 		void insertPhi(BasicBlock*);
 		void clear();			
+		void writeStats(Function &F);
 
 		set<pair<Value*, Instruction*> > LoadsAdded;
 		set<pair<Value*, Instruction*> > StoresAdded;
@@ -51,17 +255,49 @@ namespace {
 		map<BasicBlock*, map<Value*, set<BasicBlock*> > > ComesFrom;
 		map<BasicBlock*, bool> Change;
 		set<Value*> MemoryObjects;
+		set<pair<Value*, BasicBlock*> > DirtyExits;
+		set<Value*> ReadFirst;
 		map<Value*, unsigned> Alignment;
 		LoopInfo *LI;
+		AliasAnalysis *AA;
+		DominatorTree *DT;
+		TargetData *TD;
+		PromotionStats Stats;
 	};
 
 	char RegPromotion::ID = 0;
 	static RegisterPass<RegPromotion> tmp("promote", "promotes loads and stores", false, false);
 }
 
+//returns the address of a load or store
+static Value *pointerOperand(Instruction *I)
+{
+	if(LoadInst *load = dyn_cast<LoadInst>(I))
+		return load->getOperand(0);
+	return cast<StoreInst>(I)->getOperand(1);
+}
+
+//this IR has no atomic or ordered loads and stores: atomics are llvm.atomic.*
+//intrinsic calls, and the call check rejects every object they may write. Volatile
+//is the only ordering a load or store can carry.
+static bool isVolatileAccess(Instruction *I)
+{
+	if(LoadInst *load = dyn_cast<LoadInst>(I))
+		return load->isVolatile();
+	return cast<StoreInst>(I)->isVolatile();
+}
+
 //finds loads and stores to be added
 bool RegPromotion::findLoadsAndStoresAdded(Loop *L)
 {
+	//the exit stores take the value the object has in the loop, which only reaches
+	//an exit block that is entered from the loop alone
+	if(!L->getLoopPreheader() || !L->hasDedicatedExits())
+	{
+		DEBUG(dbgs()<<"No preheader or dedicated exits\n");
+		return false;
+	}
+
 	//load to be inserted in loop preheader
 	Instruction* insertLoadBefore = L->getLoopPreheader()->getTerminator(),*preheader;
 	preheader = insertLoadBefore;
@@ -73,55 +309,387 @@ bool RegPromotion::findLoadsAndStoresAdded(Loop *L)
 	for(SmallVectorImpl<BasicBlock*>::iterator i = insertStoreInBlocks.begin(); i != insertStoreInBlocks.end(); i++)
 		insertStoreBefore.push_back((*i)->begin());
 
-	//forward scan for loads
+	//calls are checked against the objects once all of them are known
+	vector<Instruction*> calls;
+
+	//non-volatile accesses of loop-invariant addresses, by address, the addresses in
+	//the order they are first accessed, and all other accesses
+	map<Value*, vector<Instruction*> > candidates;
+	vector<Value*> addresses;
+	vector<Instruction*> others;
+
+	//forward scan for loads and stores
 	for(Loop::block_iterator i = L->block_begin(); i != L->block_end(); i++)
 	{
 		for(BasicBlock::iterator j = (*i)->begin(); j != (*i)->end(); j++)
 		{
-			if(isa<CallInst>(j) || (isa<LoadInst>(j) && (!isa<GlobalVariable>(j->getOperand(0)) && !isa<GetElementPtrInst>(j->getOperand(0)))))
-			{
-				return false;
-			}
-			else if(isa<LoadInst>(j) && !(dyn_cast<LoadInst>(j)->isVolatile()))
+			if(isa<DbgInfoIntrinsic>(j))
+				continue;
+			if(isa<CallInst>(j) || isa<InvokeInst>(j))
+				calls.push_back(j);
+			else if(isa<LoadInst>(j) || isa<StoreInst>(j))
 			{
-				if(!isa<GetElementPtrInst>(j->getOperand(0)))
+				Value *address = invariantAddress(L, pointerOperand(j));
+				if(address && !isVolatileAccess(j))
 				{
-					LoadsAdded.insert(pair<Value*, Instruction*>(j->getOperand(0), insertLoadBefore));	
-					MemoryObjects.insert(j->getOperand(0));
-					Alignment[j->getOperand(0)] = dyn_cast<LoadInst>(j)->getAlignment();
-					deadLoads.insert(j);
+					if(candidates[address].empty())
+						addresses.push_back(address);
+					candidates[address].push_back(j);
 				}
+				else
+					others.push_back(j);
 			}
 		}
+	}
 
-		for(BasicBlock::iterator j = (*i)->begin(); j != (*i)->end(); j++)
+	//group the addresses by must-alias, the first address of a group in the order of
+	//the blocks stands for it
+	map<Value*, Value*> group;
+	vector<Value*> objects;
+	for(vector<Value*>::iterator a = addresses.begin(); a != addresses.end(); a++)
+	{
+		Value *object = *a;
+		for(vector<Value*>::iterator o = objects.begin(); o != objects.end(); o++)
 		{
-			if(isa<CallInst>(j) || (isa<StoreInst>(j) && !isa<GlobalVariable>(j->getOperand(1))&& !isa<GetElementPtrInst>(j->getOperand(1))))
-				return false;
-			if(isa<StoreInst>(j) && !(dyn_cast<StoreInst>(j)->isVolatile()))
+			if((*o)->getType() == object->getType()
+					&& AA->alias(object, accessSize(object), *o, accessSize(*o)) == AliasAnalysis::MustAlias)
 			{
-				if(!isa<GetElementPtrInst>(j->getOperand(1)))
+				object = *o;
+				break;
+			}
+		}
+		if(object == *a)
+			objects.push_back(object);
+		group[*a] = object;
+	}
+
+	//a group stays in memory if another group or any other access may alias it, or
+	//if its preheader load could trap where the loop would not have loaded it
+	set<Value*> rejected;
+	for(unsigned o = 0; o != objects.size(); o++)
+	{
+		for(unsigned p = o + 1; p != objects.size(); p++)
+		{
+			if(AA->alias(objects[o], accessSize(objects[o]), objects[p], accessSize(objects[p])) != AliasAnalysis::NoAlias)
+			{
+				rejected.insert(objects[o]);
+				rejected.insert(objects[p]);
+			}
+		}
+		for(vector<Instruction*>::iterator j = others.begin(); j != others.end(); j++)
+		{
+			Value *address = pointerOperand(*j);
+			if(AA->alias(objects[o], accessSize(objects[o]), address, accessSize(address)) != AliasAnalysis::NoAlias)
+				rejected.insert(objects[o]);
+		}
+	}
+	for(unsigned o = 0; o != objects.size(); o++)
+	{
+		if(rejected.count(objects[o]))
+			continue;
+		vector<Instruction*> accesses;
+		for(map<Value*, Value*>::iterator g = group.begin(); g != group.end(); g++)
+			if(g->second == objects[o])
+				accesses.insert(accesses.end(), candidates[g->first].begin(), candidates[g->first].end());
+		if(!isSafeToLoad(L, objects[o], accesses))
+			rejected.insert(objects[o]);
+	}
+	NumObjectsMayAlias += rejected.size();
+
+	//a call in the loop may clobber a group too. Nothing is rewritten or hoisted
+	//before every rejection is known.
+	set<Value*> stored;
+	for(map<Value*, vector<Instruction*> >::iterator c = candidates.begin(); c != candidates.end(); c++)
+		for(vector<Instruction*>::iterator j = c->second.begin(); j != c->second.end(); j++)
+			if(isa<StoreInst>(*j))
+				stored.insert(group[c->first]);
+	rejectClobberedObjects(calls, objects, stored, rejected);
+
+	//the accesses of a group all use the address that stands for it, hoisted to the
+	//preheader if it was computed in the loop. The promoted accesses get the
+	//smallest alignment of the group.
+	for(vector<Value*>::iterator o = objects.begin(); o != objects.end(); o++)
+	{
+		bool changed;
+		if(!rejected.count(*o) && !L->makeLoopInvariant(*o, changed))
+			rejected.insert(*o);
+	}
+	for(map<Value*, vector<Instruction*> >::iterator c = candidates.begin(); c != candidates.end(); c++)
+	{
+		Value *object = group[c->first];
+		if(rejected.count(object))
+			continue;
+		for(vector<Instruction*>::iterator j = c->second.begin(); j != c->second.end(); j++)
+		{
+			unsigned alignment;
+			if(LoadInst *load = dyn_cast<LoadInst>(*j))
+			{
+				load->setOperand(0, object);
+				LoadsAdded.insert(pair<Value*, Instruction*>(object, insertLoadBefore));
+				alignment = accessAlignment(object, load->getAlignment());
+				deadLoads.insert(load);
+			}
+			else
+			{
+				StoreInst *store = cast<StoreInst>(*j);
+				store->setOperand(1, object);
+				for(vector<Instruction*>::iterator i = insertStoreBefore.begin(); i != insertStoreBefore.end(); i++)
 				{
-					for(vector<Instruction*>::iterator i = insertStoreBefore.begin(); i != insertStoreBefore.end(); i++)
-					{
-						StoresAdded.insert(pair<Value*, Instruction*>(j->getOperand(1), *i));
-					}
-					if(MemoryObjects.count(j->getOperand(1)) == 0)
-					{
-						LoadsAdded.insert(pair<Value*, Instruction*>(j->getOperand(1), preheader));
-						MemoryObjects.insert(j->getOperand(1));
-						Alignment[j->getOperand(1)] = (dyn_cast<StoreInst>(j))->getAlignment();
-					}
-	          		deadStores.insert(j);
-	          	}
-	       	}
-	    }
+					StoresAdded.insert(pair<Value*, Instruction*>(object, *i));
+				}
+				if(MemoryObjects.count(object) == 0)
+					LoadsAdded.insert(pair<Value*, Instruction*>(object, preheader));
+				alignment = accessAlignment(object, store->getAlignment());
+				deadStores.insert(store);
+			}
+			if(MemoryObjects.insert(object).second || alignment < Alignment[object])
+				Alignment[object] = alignment;
+		}
 	}
 
-	NumStoresSunk += StoresAdded.size();
+	return !MemoryObjects.empty();
+}
+
+//true if Loop::makeLoopInvariant would succeed on the value, without moving
+//anything: it is defined outside the loop, or computed from such values by
+//instructions that can be hoisted
+static bool canMakeLoopInvariant(Loop *L, Value *V)
+{
+	if(L->isLoopInvariant(V))
+		return true;
+	Instruction *I = cast<Instruction>(V);
+	if(!I->isSafeToSpeculativelyExecute() || I->mayReadFromMemory())
+		return false;
+	for(unsigned i = 0; i != I->getNumOperands(); i++)
+		if(!canMakeLoopInvariant(L, I->getOperand(i)))
+			return false;
 	return true;
 }
 
+//returns the address if it is the same in every iteration of the loop, or a
+//getelementptr that can be hoisted to the preheader to make it so; null otherwise.
+//Nothing is hoisted here, only the addresses of the promoted objects are.
+Value *RegPromotion::invariantAddress(Loop *L, Value *address)
+{
+	if(L->isLoopInvariant(address))
+		return address;
+	if(isa<GetElementPtrInst>(address) && canMakeLoopInvariant(L, address))
+		return address;
+	return 0;
+}
+
+//returns the number of bytes accessed through the address
+uint64_t RegPromotion::accessSize(Value *address)
+{
+	return AA->getTypeStoreSize(cast<PointerType>(address->getType())->getElementType());
+}
+
+//returns the alignment an access through the address promises. An unspecified one
+//is the ABI alignment of the type, or a single byte without target data.
+unsigned RegPromotion::accessAlignment(Value *address, unsigned alignment)
+{
+	if(alignment)
+		return alignment;
+	if(!TD)
+		return 1;
+	return TD->getABITypeAlignment(cast<PointerType>(address->getType())->getElementType());
+}
+
+//the load added to the preheader runs on every entry to the loop: this is safe for
+//globals and constant offsets that stay inside them, or when one of the accesses of
+//the loop dominates every exit, so the loop would have made it anyway. A loop
+//without exits may never reach an access that is under a condition.
+bool RegPromotion::isSafeToLoad(Loop *L, Value *object, const vector<Instruction*> &accesses)
+{
+	if(isa<GlobalVariable>(object) || isInsideGlobal(object))
+		return true;
+
+	SmallVector<BasicBlock*, 8> exits;
+	L->getUniqueExitBlocks(exits);
+	if(exits.empty())
+		return false;
+	for(vector<Instruction*>::const_iterator j = accesses.begin(); j != accesses.end(); j++)
+	{
+		bool dominates = true;
+		for(unsigned e = 0; e != exits.size() && dominates; e++)
+			dominates = DT->dominates((*j)->getParent(), exits[e]);
+		if(dominates)
+			return true;
+	}
+	return false;
+}
+
+//true for a constant getelementptr into a global whose whole access lies inside the
+//global; inbounds alone does not promise that
+bool RegPromotion::isInsideGlobal(Value *object)
+{
+	GEPOperator *gep = dyn_cast<GEPOperator>(object);
+	if(!TD || !gep || !isa<Constant>(gep))
+		return false;
+	GlobalVariable *global = dyn_cast<GlobalVariable>(gep->getPointerOperand());
+	if(!global)
+		return false;
+	SmallVector<Value*, 8> indices(gep->idx_begin(), gep->idx_end());
+	for(unsigned i = 0; i != indices.size(); i++)
+		if(!isa<ConstantInt>(indices[i]))
+			return false;
+	int64_t offset = TD->getIndexedOffset(global->getType(), indices.data(), indices.size());
+	uint64_t size = TD->getTypeAllocSize(global->getType()->getElementType());
+	return offset >= 0 && (uint64_t)offset + accessSize(object) <= size;
+}
+
+//leaves an object in memory when a call in the loop may write it, or may read it
+//while the loop stores it: the promoted value would be stale across the call.
+//Calls that do not touch any promoted object are kept in the loop as they are.
+void RegPromotion::rejectClobberedObjects(const vector<Instruction*> &calls, const vector<Value*> &objects,
+		const set<Value*> &stored, set<Value*> &rejected)
+{
+	set<Value*> clobbered;
+	for(vector<Instruction*>::const_iterator c = calls.begin(); c != calls.end(); c++)
+	{
+		ImmutableCallSite CS(*c);
+		bool touches = false;
+		for(vector<Value*>::const_iterator o = objects.begin(); o != objects.end(); o++)
+		{
+			if(rejected.count(*o))
+				continue;
+			const Type *type = cast<PointerType>((*o)->getType())->getElementType();
+			AliasAnalysis::ModRefResult modref = AA->getModRefInfo(CS, *o, AA->getTypeStoreSize(type));
+			if(modref == AliasAnalysis::NoModRef)
+				continue;
+			touches = true;
+			if((modref & AliasAnalysis::Mod) || stored.count(*o))
+			{
+				DEBUG(dbgs()<<"Call "<<**c<<" clobbers "<<(*o)->getName()<<'\n');
+				clobbered.insert(*o);
+			}
+		}
+		if(!touches)
+			NumCallsIgnored++;
+	}
+
+	rejected.insert(clobbered.begin(), clobbered.end());
+	NumObjectsClobbered += clobbered.size();
+}
+
+//Finds, for every promoted object, the exits where it may be dirty and whether the
+//loop may read it before writing it. An object is dirty on the paths from the
+//header that pass a store of it: the exit stores are kept only where some path is
+//dirty, and the preheader load only for objects that a load sees clean. An exit
+//where only some paths are dirty stores the value coming into the loop on the clean
+//ones, so the preheader load stays for it too.
+void RegPromotion::trackDirtyState(Loop *L)
+{
+	SmallVector<BasicBlock*, 8> exits;
+	L->getUniqueExitBlocks(exits);
+	vector<Value*> objects(MemoryObjects.begin(), MemoryObjects.end());
+	map<Value*, unsigned> number;
+	for(unsigned o = 0; o != objects.size(); o++)
+		number[objects[o]] = o;
+
+	//the conservative answer: every stored object at every exit, every object loaded
+	set<Value*> stored;
+	for(set<Instruction*>::iterator i = deadStores.begin(); i != deadStores.end(); i++)
+		stored.insert((*i)->getOperand(1));
+	if(!DirtyTracking)
+	{
+		for(set<Value*>::iterator o = stored.begin(); o != stored.end(); o++)
+			for(unsigned e = 0; e != exits.size(); e++)
+				DirtyExits.insert(make_pair(*o, exits[e]));
+		ReadFirst = MemoryObjects;
+		return;
+	}
+
+	//may-dirty and must-dirty out of every loop block; must starts full and shrinks
+	BasicBlock *header = L->getHeader();
+	map<BasicBlock*, BitVector> Writes, MayOut, MustOut;
+	for(Loop::block_iterator b = L->block_begin(); b != L->block_end(); b++)
+	{
+		Writes[*b].resize(objects.size());
+		MayOut[*b].resize(objects.size());
+		MustOut[*b].resize(objects.size(), true);
+		for(BasicBlock::iterator j = (*b)->begin(); j != (*b)->end(); j++)
+			if(isa<StoreInst>(j) && deadStores.count(j))
+				Writes[*b].set(number[j->getOperand(1)]);
+	}
+	bool change = true;
+	while(change)
+	{
+		change = false;
+		for(Loop::block_iterator b = L->block_begin(); b != L->block_end(); b++)
+		{
+			BitVector may(objects.size()), must(objects.size(), *b != header);
+			for(pred_iterator pi = pred_begin(*b); pi != pred_end(*b); ++pi)
+			{
+				if(!L->contains(*pi))
+					continue;
+				may |= MayOut[*pi];
+				must &= MustOut[*pi];
+			}
+			may |= Writes[*b];
+			must |= Writes[*b];
+			if(may != MayOut[*b] || must != MustOut[*b])
+			{
+				MayOut[*b] = may;
+				MustOut[*b] = must;
+				change = true;
+			}
+		}
+	}
+
+	//a load reads the value from the preheader unless a store comes first on every path
+	for(Loop::block_iterator b = L->block_begin(); b != L->block_end(); b++)
+	{
+		BitVector written(objects.size(), *b != header);
+		for(pred_iterator pi = pred_begin(*b); pi != pred_end(*b); ++pi)
+			if(L->contains(*pi))
+				written &= MustOut[*pi];
+		for(BasicBlock::iterator j = (*b)->begin(); j != (*b)->end(); j++)
+		{
+			if(isa<LoadInst>(j) && deadLoads.count(j) && !written.test(number[j->getOperand(0)]))
+				ReadFirst.insert(j->getOperand(0));
+			else if(isa<StoreInst>(j) && deadStores.count(j))
+				written.set(number[j->getOperand(1)]);
+		}
+	}
+
+	for(unsigned e = 0; e != exits.size(); e++)
+	{
+		BitVector may(objects.size()), must(objects.size(), true);
+		for(pred_iterator pi = pred_begin(exits[e]); pi != pred_end(exits[e]); ++pi)
+		{
+			if(!L->contains(*pi))
+				continue;
+			may |= MayOut[*pi];
+			must &= MustOut[*pi];
+		}
+		for(set<Value*>::iterator o = stored.begin(); o != stored.end(); o++)
+		{
+			unsigned n = number[*o];
+			if(!may.test(n))
+			{
+				NumExitStoresSkipped++;
+				continue;
+			}
+			DirtyExits.insert(make_pair(*o, exits[e]));
+			if(!must.test(n))
+				ReadFirst.insert(*o);
+		}
+	}
+	//the map-based rewrite starts every object from its preheader load, and inserts
+	//the exit stores it is given
+	if(!UseSSAUpdater && !DenseDataflow)
+		ReadFirst = MemoryObjects;
+	NumPreheaderLoadsSkipped += objects.size() - ReadFirst.size();
+	for(set<pair<Value*, Instruction*> >::iterator i = StoresAdded.begin(); i != StoresAdded.end();)
+	{
+		if(DirtyExits.count(make_pair(i->first, i->second->getParent())))
+			i++;
+		else
+			StoresAdded.erase(i++);
+	}
+}
+
 //inserts loads from loads added set
 void RegPromotion::insertLoads()
 {
@@ -371,6 +939,351 @@ void RegPromotion::replaceLoadsByCopies(Loop* L)
 	}
 }
 
+//numbers the preheader, then the loop blocks in reverse post-order from the header,
+//then the exit blocks
+void PromotionDataflow::numberBlocks(Loop *L, SmallVectorImpl<BasicBlock*> &exits)
+{
+	Blocks.push_back(L->getLoopPreheader());
+
+	vector<BasicBlock*> postOrder;
+	set<BasicBlock*> visited;
+	vector<pair<BasicBlock*, succ_iterator> > stack;
+	visited.insert(L->getHeader());
+	stack.push_back(make_pair(L->getHeader(), succ_begin(L->getHeader())));
+	while(!stack.empty())
+	{
+		BasicBlock *BB = stack.back().first;
+		succ_iterator &si = stack.back().second;
+		if(si == succ_end(BB))
+		{
+			postOrder.push_back(BB);
+			stack.pop_back();
+			continue;
+		}
+		BasicBlock *succ = *si;
+		++si;
+		if(L->contains(succ) && visited.insert(succ).second)
+			stack.push_back(make_pair(succ, succ_begin(succ)));
+	}
+	Blocks.insert(Blocks.end(), postOrder.rbegin(), postOrder.rend());
+	NumLoopBlocks = postOrder.size();
+	Blocks.insert(Blocks.end(), exits.begin(), exits.end());
+	for(unsigned b = 0; b != Blocks.size(); b++)
+		BlockNumber[Blocks[b]] = b;
+}
+
+//gives every object a contiguous range of definitions: the preheader load, its
+//stores in the loop and one phi per block. An object written before it is read
+//comes into the loop undefined instead of loaded.
+void PromotionDataflow::numberDefs(Instruction *preheaderEnd, const set<Instruction*> &stores,
+		const set<Value*> &readFirst, map<Value*, unsigned> &alignment)
+{
+	NumStores.assign(Objects.size(), 0);
+	for(set<Instruction*>::const_iterator si = stores.begin(); si != stores.end(); si++)
+		NumStores[ObjectNumber[(*si)->getOperand(1)]]++;
+
+	unsigned next = 0;
+	for(unsigned o = 0; o != Objects.size(); o++)
+	{
+		DefBegin.push_back(next);
+		if(readFirst.count(Objects[o]))
+		{
+			LoadInst *load = new LoadInst(Objects[o], Objects[o]->getName(), preheaderEnd);
+			load->setAlignment(alignment[Objects[o]]);
+			DefValue.push_back(load);
+		}
+		else
+			DefValue.push_back(UndefValue::get(cast<PointerType>(Objects[o]->getType())->getElementType()));
+		next++;
+		next += NumStores[o];
+		DefValue.resize(next, 0);
+		next += Blocks.size();
+		DefValue.resize(next, 0);
+	}
+	DefBegin.push_back(next);
+
+	//stores in the order of the blocks, so that the numbering is deterministic
+	vector<unsigned> used(Objects.size(), 0);
+	for(unsigned b = 0; b != Blocks.size(); b++)
+	{
+		for(BasicBlock::iterator j = Blocks[b]->begin(); j != Blocks[b]->end(); j++)
+		{
+			if(!isa<StoreInst>(j) || !stores.count(j))
+				continue;
+			unsigned o = ObjectNumber[j->getOperand(1)];
+			unsigned def = DefBegin[o] + 1 + used[o]++;
+			StoreDef[j] = def;
+			DefValue[def] = j->getOperand(0);
+		}
+	}
+	Words = (next + 63) / 64;
+}
+
+//recomputes IN and OUT of a block, returns true if OUT changed
+bool PromotionDataflow::transfer(unsigned block)
+{
+	uint64_t *in = IN[block];
+	//the preheader is where the dataflow starts, nothing flows into it. Elsewhere IN
+	//is rebuilt from the predecessors, since a definition a predecessor has since
+	//replaced with a phi must not stay in it. Only a phi, once placed, is kept.
+	if(block != 0)
+	{
+		BitVector hadPhi(Objects.size());
+		for(unsigned o = 0; o != Objects.size(); o++)
+			if(test(in, phiDef(block, o)))
+				hadPhi.set(o);
+		for(unsigned w = 0; w != Words; w++)
+			in[w] = 0;
+		for(int o = hadPhi.find_first(); o != -1; o = hadPhi.find_next(o))
+			set(in, phiDef(block, o));
+		for(pred_iterator pi = pred_begin(Blocks[block]); pi != pred_end(Blocks[block]); ++pi)
+		{
+			DenseMap<BasicBlock*, unsigned>::iterator bi = BlockNumber.find(*pi);
+			if(bi == BlockNumber.end())
+				continue;
+			for(unsigned w = 0; w != Words; w++)
+				in[w] |= OUT[bi->second][w];
+		}
+	}
+	//more than one definition of an object: a phi takes their place
+	for(unsigned o = 0; o != Objects.size(); o++)
+	{
+		unsigned phi = phiDef(block, o);
+		bool hasPhi = test(in, phi);
+		if(hasPhi || countRange(in, DefBegin[o], DefBegin[o + 1]) > 1)
+		{
+			resetRange(in, DefBegin[o], DefBegin[o + 1]);
+			set(in, phi);
+		}
+	}
+	bool changed = false;
+	for(unsigned w = 0; w != Words; w++)
+	{
+		uint64_t out = GEN[block][w] | (in[w] & ~KILL[block][w]);
+		if(out != OUT[block][w])
+		{
+			OUT[block][w] = out;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+void PromotionDataflow::solve(Loop *L, const set<Value*> &objects, const set<Instruction*> &stores,
+		const set<Value*> &readFirst, map<Value*, unsigned> &alignment)
+{
+	SmallVector<BasicBlock*, 8> exits;
+	L->getUniqueExitBlocks(exits);
+	numberBlocks(L, exits);
+	for(set<Value*>::const_iterator oi = objects.begin(); oi != objects.end(); oi++)
+	{
+		ObjectNumber[*oi] = Objects.size();
+		Objects.push_back(*oi);
+	}
+	numberDefs(L->getLoopPreheader()->getTerminator(), stores, readFirst, alignment);
+
+	for(unsigned b = 0; b != Blocks.size(); b++)
+	{
+		IN.push_back(newBits());
+		OUT.push_back(newBits());
+		GEN.push_back(newBits());
+		KILL.push_back(newBits());
+	}
+	//the preheader defines every object with its load
+	for(unsigned o = 0; o != Objects.size(); o++)
+	{
+		setRange(KILL[0], DefBegin[o], DefBegin[o + 1]);
+		set(GEN[0], DefBegin[o]);
+	}
+	//the last store of an object in a block kills every other definition of it
+	for(unsigned b = 1; b <= NumLoopBlocks; b++)
+	{
+		for(BasicBlock::iterator j = Blocks[b]->begin(); j != Blocks[b]->end(); j++)
+		{
+			DenseMap<Instruction*, unsigned>::iterator si = StoreDef.find(j);
+			if(si == StoreDef.end())
+				continue;
+			unsigned o = ObjectNumber[j->getOperand(1)];
+			setRange(KILL[b], DefBegin[o], DefBegin[o + 1]);
+			resetRange(GEN[b], DefBegin[o], DefBegin[o + 1]);
+			set(GEN[b], si->second);
+		}
+	}
+
+	BitVector pending(Blocks.size(), true);
+	for(int b = pending.find_first(); b != -1; b = pending.find_first())
+	{
+		pending.reset(b);
+		if(!transfer(b))
+			continue;
+		for(succ_iterator si = succ_begin(Blocks[b]); si != succ_end(Blocks[b]); ++si)
+		{
+			DenseMap<BasicBlock*, unsigned>::iterator bi = BlockNumber.find(*si);
+			if(bi != BlockNumber.end() && bi->second != 0)
+				pending.set(bi->second);
+		}
+	}
+}
+
+//the value of the object described by the bits, creating the phi of the block if
+//that is what reaches
+Value *PromotionDataflow::reachingValue(unsigned block, unsigned object, const uint64_t *bits)
+{
+	for(unsigned d = DefBegin[object]; d != DefBegin[object + 1]; d++)
+	{
+		if(!test(bits, d))
+			continue;
+		if(d != phiDef(block, object) || DefValue[d])
+			return DefValue[d];
+		PHINode *phi = PHINode::Create(cast<PointerType>(Objects[object]->getType())->getElementType(),
+				Objects[object]->getName(), Blocks[block]->begin());
+		DefValue[d] = phi;
+		Phis.push_back(phi);
+		return phi;
+	}
+	return 0;
+}
+
+//Materializes the solution: the phis get their incoming values, every promoted
+//load is replaced by the value that reaches it, and the exit blocks store the value
+//of every object that may be dirty there
+void PromotionDataflow::rewrite(const set<Instruction*> &loads, const set<pair<Value*, BasicBlock*> > &dirtyExits,
+		map<Value*, unsigned> &alignment)
+{
+	//a load may be replaced by the value of another promoted load, which is
+	//itself replaced later, so the replacements are resolved at the end
+	DenseMap<Value*, Value*> Replacement;
+	vector<pair<unsigned, unsigned> > PhiBlocks;
+	for(unsigned b = 0; b != Blocks.size(); b++)
+	{
+		for(unsigned o = 0; o != Objects.size(); o++)
+		{
+			if(test(IN[b], phiDef(b, o)))
+			{
+				reachingValue(b, o, IN[b]);
+				PhiBlocks.push_back(make_pair(b, o));
+			}
+		}
+	}
+	for(unsigned b = 1; b <= NumLoopBlocks; b++)
+	{
+		uint64_t *current = newBits();
+		std::copy(IN[b], IN[b] + Words, current);
+		for(BasicBlock::iterator j = Blocks[b]->begin(); j != Blocks[b]->end(); j++)
+		{
+			if(isa<LoadInst>(j) && loads.count(j))
+			{
+				unsigned o = ObjectNumber[j->getOperand(0)];
+				if(Value *v = reachingValue(b, o, current))
+					Replacement[j] = v;
+			}
+			DenseMap<Instruction*, unsigned>::iterator si = StoreDef.find(j);
+			if(si != StoreDef.end())
+			{
+				unsigned o = ObjectNumber[j->getOperand(1)];
+				resetRange(current, DefBegin[o], DefBegin[o + 1]);
+				set(current, si->second);
+			}
+		}
+	}
+
+	//exit stores, for the objects that may be dirty at the exit
+	for(unsigned b = NumLoopBlocks + 1; b != Blocks.size(); b++)
+	{
+		Instruction *insertBefore = Blocks[b]->getFirstNonPHI();
+		for(unsigned o = 0; o != Objects.size(); o++)
+		{
+			if(!dirtyExits.count(make_pair(Objects[o], Blocks[b])))
+				continue;
+			if(Value *v = reachingValue(b, o, IN[b]))
+			{
+				StoreInst *st = new StoreInst(v, Objects[o], insertBefore);
+				st->setAlignment(alignment[Objects[o]]);
+			}
+		}
+	}
+
+	//incoming values of the phis, from the OUT of every predecessor in the region
+	for(unsigned i = 0; i != PhiBlocks.size(); i++)
+	{
+		unsigned b = PhiBlocks[i].first, o = PhiBlocks[i].second;
+		PHINode *phi = cast<PHINode>(DefValue[phiDef(b, o)]);
+		for(pred_iterator pi = pred_begin(Blocks[b]); pi != pred_end(Blocks[b]); ++pi)
+		{
+			DenseMap<BasicBlock*, unsigned>::iterator bi = BlockNumber.find(*pi);
+			if(bi == BlockNumber.end() || phi->getBasicBlockIndex(*pi) != -1)
+				continue;
+			if(Value *v = reachingValue(bi->second, o, OUT[bi->second]))
+				phi->addIncoming(v, *pi);
+		}
+	}
+
+	for(DenseMap<Value*, Value*>::iterator ri = Replacement.begin(); ri != Replacement.end(); ri++)
+	{
+		Value *v = ri->second;
+		for(unsigned steps = 0; steps <= Replacement.size(); steps++)
+		{
+			DenseMap<Value*, Value*>::iterator next = Replacement.find(v);
+			if(next == Replacement.end())
+				break;
+			v = next->second;
+		}
+		cast<Instruction>(ri->first)->replaceAllUsesWith(v);
+	}
+}
+
+//replaceLoadsByCopies on the dense dataflow: the preheader loads, the phis, the
+//copies and the exit stores come out the same, but the dataflow is solved before
+//anything is rewritten
+void RegPromotion::replaceLoadsByCopiesDense(Loop* L)
+{
+	set<Value*> objects;
+	for(set<pair<Value*, Instruction*> >::iterator i = LoadsAdded.begin(); i != LoadsAdded.end(); i++)
+		objects.insert(i->first);
+	PromotionDataflow dataflow;
+	dataflow.solve(L, objects, deadStores, ReadFirst, Alignment);
+	dataflow.rewrite(deadLoads, DirtyExits, Alignment);
+}
+
+//Rewrites every promoted object with its own SSAUpdater: the load added to the
+//preheader is the value coming into the loop, the loads and stores of the object in
+//the loop are rewritten in one pass, and every object is stored back in the exit
+//blocks where it may be dirty. The promoter deletes the loads and stores it rewrote.
+void RegPromotion::promoteWithSSAUpdater(Loop* L)
+{
+	BasicBlock *preheader = L->getLoopPreheader();
+
+	map<Value*, SmallVector<Instruction*, 16> > Accesses;
+	map<Value*, SmallVector<BasicBlock*, 8> > Exits;
+	for(set<pair<Value*, Instruction*> >::iterator i = LoadsAdded.begin(); i != LoadsAdded.end(); i++)
+		Accesses[i->first];
+	for(set<Instruction*>::iterator i = deadLoads.begin(); i != deadLoads.end(); i++)
+		Accesses[(*i)->getOperand(0)].push_back(*i);
+	for(set<Instruction*>::iterator i = deadStores.begin(); i != deadStores.end(); i++)
+		Accesses[(*i)->getOperand(1)].push_back(*i);
+	for(set<pair<Value*, BasicBlock*> >::iterator i = DirtyExits.begin(); i != DirtyExits.end(); i++)
+		Exits[i->first].push_back(i->second);
+
+	for(map<Value*, SmallVector<Instruction*, 16> >::iterator i = Accesses.begin(); i != Accesses.end(); i++)
+	{
+		Value *object = i->first;
+		SmallVector<PHINode*, 16> NewPHIs;
+		SSAUpdater SSA(&NewPHIs);
+		ObjectPromoter promoter(object, i->second, SSA, Exits[object], Alignment[object]);
+		if(ReadFirst.count(object))
+		{
+			LoadInst *load = new LoadInst(object, object->getName() + ".promoted", preheader->getTerminator());
+			load->setAlignment(Alignment[object]);
+			SSA.AddAvailableValue(preheader, load);
+		}
+		else
+			SSA.AddAvailableValue(preheader, UndefValue::get(cast<PointerType>(object->getType())->getElementType()));
+		promoter.run(i->second);
+	}
+	deadLoads.clear();
+	deadStores.clear();
+}
+
 //deletes dead loads from loop
 void RegPromotion::deleteDeadLoads()
 {
@@ -378,7 +1291,9 @@ void RegPromotion::deleteDeadLoads()
 	{
 		(*i)->eraseFromParent();
 	}
-	NumLoadsHoisted += LoadsAdded.size();
+	//only the objects that kept their preheader load had a load hoisted
+	NumLoadsHoisted += ReadFirst.size();
+	Stats.LoadsHoisted += ReadFirst.size();
 }
 
 //deletes dead stores from loop
@@ -395,6 +1310,10 @@ void RegPromotion::clear()
 {
 	IN_BBVRMap.clear();
 	OUT_BBVRMap.clear();
+	MemoryObjects.clear();
+	Alignment.clear();
+	DirtyExits.clear();
+	ReadFirst.clear();
 	deadStores.clear();
 	deadLoads.clear();
 	LoadsAdded.clear();
@@ -410,19 +1329,51 @@ void RegPromotion::clear()
 //promotes loads and stores within a loop
 void RegPromotion::promoteInLoop(Loop* L)
 {
-	bool promotable = findLoadsAndStoresAdded(L);
+	bool promotable;
+	Stats.Loops++;
+	{
+		PhaseTimer timer("Candidate scan", TimerGroup, Stats.ScanTime);
+		promotable = findLoadsAndStoresAdded(L);
+	}
 	if(promotable)
 	{
-		errs()<<"Pass executed\n";
-		insertLoads();
-		replaceLoadsByCopies(L);
+		DEBUG(dbgs()<<"Pass executed\n");
+		Stats.PromotedLoops++;
+		Stats.PromotedObjects += LoadsAdded.size();
+		{
+			PhaseTimer timer("Candidate scan", TimerGroup, Stats.ScanTime);
+			trackDirtyState(L);
+		}
+		NumStoresSunk += StoresAdded.size();
+		Stats.StoresSunk += StoresAdded.size();
+		if(UseSSAUpdater)
+		{
+			PhaseTimer timer("Dataflow", TimerGroup, Stats.DataflowTime);
+			promoteWithSSAUpdater(L);
+		}
+		else if(DenseDataflow)
+		{
+			PhaseTimer timer("Dataflow", TimerGroup, Stats.DataflowTime);
+			replaceLoadsByCopiesDense(L);
+		}
+		else
+		{
+			{
+				PhaseTimer timer("Rewrite to copies", TimerGroup, Stats.RewriteTime);
+				insertLoads();
+			}
+			PhaseTimer timer("Dataflow", TimerGroup, Stats.DataflowTime);
+			replaceLoadsByCopies(L);
+		}
+		PhaseTimer timer("Rewrite to copies", TimerGroup, Stats.RewriteTime);
 		deleteDeadLoads();
 		deleteDeadStores();
 		clear();
 	}
 	else
 	{
-		errs()<<"Pass not executed\n";
+		DEBUG(dbgs()<<"Pass not executed\n");
+		clear();
 	}
 }
 
@@ -472,16 +1423,47 @@ void callMem2reg(Function &F,DominatorTree &DT)
 bool RegPromotion::runOnFunction(Function &F)
 {
 	LI = &getAnalysis<LoopInfo>();
-	DominatorTree &DT = getAnalysis<DominatorTree>();
-	callMem2reg(F,DT);
+	AA = &getAnalysis<AliasAnalysis>();
+	TD = getAnalysisIfAvailable<TargetData>();
+	DT = &getAnalysis<DominatorTree>();
+	Stats.clear();
+	callMem2reg(F,*DT);
 	promoteAllLoops(); 
+	writeStats(F);
 	return true;
 }
 
+//appends the statistics of the function to the -promote-stats-file as one JSON line
+void RegPromotion::writeStats(Function &F)
+{
+	if(StatsFile.empty())
+		return;
+	std::string error;
+	raw_fd_ostream out(StatsFile.c_str(), error, raw_fd_ostream::F_Append);
+	if(!error.empty())
+	{
+		errs()<<"Cannot write promotion statistics to "<<StatsFile<<": "<<error<<'\n';
+		return;
+	}
+	out<<"{\"pass\":\"promote\",\"function\":";
+	writeJSONString(out, F.getName());
+	out
+		<<",\"loops\":"<<Stats.Loops
+		<<",\"promoted_loops\":"<<Stats.PromotedLoops
+		<<",\"promoted_objects\":"<<Stats.PromotedObjects
+		<<",\"loads_hoisted\":"<<Stats.LoadsHoisted
+		<<",\"stores_sunk\":"<<Stats.StoresSunk
+		<<",\"scan_seconds\":"<<Stats.ScanTime
+		<<",\"dataflow_seconds\":"<<Stats.DataflowTime
+		<<",\"rewrite_seconds\":"<<Stats.RewriteTime
+		<<"}\n";
+}
+
 void RegPromotion::getAnalysisUsage(AnalysisUsage &AU) const
 {
 	AU.setPreservesAll();
 	AU.addRequired<LoopInfo>();
 	AU.addRequired<DominatorTree>();
+	AU.addRequired<AliasAnalysis>();
 }
 
@@ -0,0 +1,114 @@
+; Triply nested loop: 64x64 double matrix multiply, repeated 20 times.
+; Exercises loop-carried accumulators and addresses that stay live across
+; the inner loop.
+
+@A = internal global [64 x [64 x double]] zeroinitializer, align 16
+@B = internal global [64 x [64 x double]] zeroinitializer, align 16
+@C = internal global [64 x [64 x double]] zeroinitializer, align 16
+@.fmt = private constant [4 x i8] c"%f\0A\00"
+
+declare i32 @printf(i8*, ...)
+
+define internal void @init() nounwind {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %sum = add i64 %i, %j
+  %sum.32 = trunc i64 %sum to i32
+  %a = sitofp i32 %sum.32 to double
+  %pa = getelementptr inbounds [64 x [64 x double]]* @A, i64 0, i64 %i, i64 %j
+  store double %a, double* %pa, align 8
+  %diff = sub i64 %i, %j
+  %diff.32 = trunc i64 %diff to i32
+  %b = sitofp i32 %diff.32 to double
+  %pb = getelementptr inbounds [64 x [64 x double]]* @B, i64 0, i64 %i, i64 %j
+  store double %b, double* %pb, align 8
+  %j.next = add i64 %j, 1
+  %j.done = icmp eq i64 %j.next, 64
+  br i1 %j.done, label %outer.latch, label %inner
+
+outer.latch:
+  %i.next = add i64 %i, 1
+  %i.done = icmp eq i64 %i.next, 64
+  br i1 %i.done, label %exit, label %outer
+
+exit:
+  ret void
+}
+
+define internal void @matmul() nounwind {
+entry:
+  br label %loop.i
+
+loop.i:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch.i ]
+  br label %loop.j
+
+loop.j:
+  %j = phi i64 [ 0, %loop.i ], [ %j.next, %latch.j ]
+  br label %loop.k
+
+loop.k:
+  %k = phi i64 [ 0, %loop.j ], [ %k.next, %loop.k ]
+  %acc = phi double [ 0.000000e+00, %loop.j ], [ %acc.next, %loop.k ]
+  %pa = getelementptr inbounds [64 x [64 x double]]* @A, i64 0, i64 %i, i64 %k
+  %a = load double* %pa, align 8
+  %pb = getelementptr inbounds [64 x [64 x double]]* @B, i64 0, i64 %k, i64 %j
+  %b = load double* %pb, align 8
+  %mul = fmul double %a, %b
+  %acc.next = fadd double %acc, %mul
+  %k.next = add i64 %k, 1
+  %k.done = icmp eq i64 %k.next, 64
+  br i1 %k.done, label %latch.j, label %loop.k
+
+latch.j:
+  %pc = getelementptr inbounds [64 x [64 x double]]* @C, i64 0, i64 %i, i64 %j
+  store double %acc.next, double* %pc, align 8
+  %j.next = add i64 %j, 1
+  %j.done = icmp eq i64 %j.next, 64
+  br i1 %j.done, label %latch.i, label %loop.j
+
+latch.i:
+  %i.next = add i64 %i, 1
+  %i.done = icmp eq i64 %i.next, 64
+  br i1 %i.done, label %exit, label %loop.i
+
+exit:
+  ret void
+}
+
+define i32 @main() nounwind {
+entry:
+  call void @init()
+  br label %repeat
+
+repeat:
+  %r = phi i32 [ 0, %entry ], [ %r.next, %repeat ]
+  call void @matmul()
+  %r.next = add i32 %r, 1
+  %r.done = icmp eq i32 %r.next, 20
+  br i1 %r.done, label %checksum, label %repeat
+
+checksum:
+  %n = phi i64 [ 0, %repeat ], [ %n.next, %checksum ]
+  %s = phi double [ 0.000000e+00, %repeat ], [ %s.next, %checksum ]
+  %row = lshr i64 %n, 6
+  %col = and i64 %n, 63
+  %pc = getelementptr inbounds [64 x [64 x double]]* @C, i64 0, i64 %row, i64 %col
+  %c = load double* %pc, align 8
+  %s.next = fadd double %s, %c
+  %n.next = add i64 %n, 1
+  %n.done = icmp eq i64 %n.next, 4096
+  br i1 %n.done, label %exit, label %checksum
+
+exit:
+  %fmt = getelementptr inbounds [4 x i8]* @.fmt, i64 0, i64 0
+  %call = call i32 (i8*, ...)* @printf(i8* %fmt, double %s.next)
+  ret i32 0
+}
@@ -0,0 +1,253 @@
+; High register pressure: 24 double and 14 integer recurrences stay live
+; across one loop, more than x86-64 has registers for. Stresses spill choice
+; and spill placement.
+
+@.fmt = private constant [9 x i8] c"%f %llu\0A\00"
+
+declare i32 @printf(i8*, ...)
+
+define i32 @main() nounwind {
+entry:
+  br label %loop
+
+loop:
+  %n = phi i32 [ 0, %entry ], [ %n.next, %loop ]
+  %x0 = phi double [ 1.000000e+00, %entry ], [ %x0.next, %loop ]
+  %x1 = phi double [ 2.000000e+00, %entry ], [ %x1.next, %loop ]
+  %x2 = phi double [ 3.000000e+00, %entry ], [ %x2.next, %loop ]
+  %x3 = phi double [ 4.000000e+00, %entry ], [ %x3.next, %loop ]
+  %x4 = phi double [ 5.000000e+00, %entry ], [ %x4.next, %loop ]
+  %x5 = phi double [ 6.000000e+00, %entry ], [ %x5.next, %loop ]
+  %x6 = phi double [ 7.000000e+00, %entry ], [ %x6.next, %loop ]
+  %x7 = phi double [ 8.000000e+00, %entry ], [ %x7.next, %loop ]
+  %x8 = phi double [ 9.000000e+00, %entry ], [ %x8.next, %loop ]
+  %x9 = phi double [ 10.000000e+00, %entry ], [ %x9.next, %loop ]
+  %x10 = phi double [ 11.000000e+00, %entry ], [ %x10.next, %loop ]
+  %x11 = phi double [ 12.000000e+00, %entry ], [ %x11.next, %loop ]
+  %x12 = phi double [ 13.000000e+00, %entry ], [ %x12.next, %loop ]
+  %x13 = phi double [ 14.000000e+00, %entry ], [ %x13.next, %loop ]
+  %x14 = phi double [ 15.000000e+00, %entry ], [ %x14.next, %loop ]
+  %x15 = phi double [ 16.000000e+00, %entry ], [ %x15.next, %loop ]
+  %x16 = phi double [ 17.000000e+00, %entry ], [ %x16.next, %loop ]
+  %x17 = phi double [ 18.000000e+00, %entry ], [ %x17.next, %loop ]
+  %x18 = phi double [ 19.000000e+00, %entry ], [ %x18.next, %loop ]
+  %x19 = phi double [ 20.000000e+00, %entry ], [ %x19.next, %loop ]
+  %x20 = phi double [ 21.000000e+00, %entry ], [ %x20.next, %loop ]
+  %x21 = phi double [ 22.000000e+00, %entry ], [ %x21.next, %loop ]
+  %x22 = phi double [ 23.000000e+00, %entry ], [ %x22.next, %loop ]
+  %x23 = phi double [ 24.000000e+00, %entry ], [ %x23.next, %loop ]
+  %h0 = phi i64 [ 7, %entry ], [ %h0.next, %loop ]
+  %h1 = phi i64 [ 10, %entry ], [ %h1.next, %loop ]
+  %h2 = phi i64 [ 13, %entry ], [ %h2.next, %loop ]
+  %h3 = phi i64 [ 16, %entry ], [ %h3.next, %loop ]
+  %h4 = phi i64 [ 19, %entry ], [ %h4.next, %loop ]
+  %h5 = phi i64 [ 22, %entry ], [ %h5.next, %loop ]
+  %h6 = phi i64 [ 25, %entry ], [ %h6.next, %loop ]
+  %h7 = phi i64 [ 28, %entry ], [ %h7.next, %loop ]
+  %h8 = phi i64 [ 31, %entry ], [ %h8.next, %loop ]
+  %h9 = phi i64 [ 34, %entry ], [ %h9.next, %loop ]
+  %h10 = phi i64 [ 37, %entry ], [ %h10.next, %loop ]
+  %h11 = phi i64 [ 40, %entry ], [ %h11.next, %loop ]
+  %h12 = phi i64 [ 43, %entry ], [ %h12.next, %loop ]
+  %h13 = phi i64 [ 46, %entry ], [ %h13.next, %loop ]
+  %n.32 = sitofp i32 %n to double
+  %t = fmul double %n.32, 1.000000e-09
+  %x0.a = fmul double %x0, 9.990000e-01
+  %x0.b = fmul double %x1, 1.000000e-03
+  %x0.c = fadd double %x0.a, %x0.b
+  %x0.next = fadd double %x0.c, %t
+  %x1.a = fmul double %x1, 9.990000e-01
+  %x1.b = fmul double %x2, 1.000000e-03
+  %x1.c = fadd double %x1.a, %x1.b
+  %x1.next = fadd double %x1.c, %t
+  %x2.a = fmul double %x2, 9.990000e-01
+  %x2.b = fmul double %x3, 1.000000e-03
+  %x2.c = fadd double %x2.a, %x2.b
+  %x2.next = fadd double %x2.c, %t
+  %x3.a = fmul double %x3, 9.990000e-01
+  %x3.b = fmul double %x4, 1.000000e-03
+  %x3.c = fadd double %x3.a, %x3.b
+  %x3.next = fadd double %x3.c, %t
+  %x4.a = fmul double %x4, 9.990000e-01
+  %x4.b = fmul double %x5, 1.000000e-03
+  %x4.c = fadd double %x4.a, %x4.b
+  %x4.next = fadd double %x4.c, %t
+  %x5.a = fmul double %x5, 9.990000e-01
+  %x5.b = fmul double %x6, 1.000000e-03
+  %x5.c = fadd double %x5.a, %x5.b
+  %x5.next = fadd double %x5.c, %t
+  %x6.a = fmul double %x6, 9.990000e-01
+  %x6.b = fmul double %x7, 1.000000e-03
+  %x6.c = fadd double %x6.a, %x6.b
+  %x6.next = fadd double %x6.c, %t
+  %x7.a = fmul double %x7, 9.990000e-01
+  %x7.b = fmul double %x8, 1.000000e-03
+  %x7.c = fadd double %x7.a, %x7.b
+  %x7.next = fadd double %x7.c, %t
+  %x8.a = fmul double %x8, 9.990000e-01
+  %x8.b = fmul double %x9, 1.000000e-03
+  %x8.c = fadd double %x8.a, %x8.b
+  %x8.next = fadd double %x8.c, %t
+  %x9.a = fmul double %x9, 9.990000e-01
+  %x9.b = fmul double %x10, 1.000000e-03
+  %x9.c = fadd double %x9.a, %x9.b
+  %x9.next = fadd double %x9.c, %t
+  %x10.a = fmul double %x10, 9.990000e-01
+  %x10.b = fmul double %x11, 1.000000e-03
+  %x10.c = fadd double %x10.a, %x10.b
+  %x10.next = fadd double %x10.c, %t
+  %x11.a = fmul double %x11, 9.990000e-01
+  %x11.b = fmul double %x12, 1.000000e-03
+  %x11.c = fadd double %x11.a, %x11.b
+  %x11.next = fadd double %x11.c, %t
+  %x12.a = fmul double %x12, 9.990000e-01
+  %x12.b = fmul double %x13, 1.000000e-03
+  %x12.c = fadd double %x12.a, %x12.b
+  %x12.next = fadd double %x12.c, %t
+  %x13.a = fmul double %x13, 9.990000e-01
+  %x13.b = fmul double %x14, 1.000000e-03
+  %x13.c = fadd double %x13.a, %x13.b
+  %x13.next = fadd double %x13.c, %t
+  %x14.a = fmul double %x14, 9.990000e-01
+  %x14.b = fmul double %x15, 1.000000e-03
+  %x14.c = fadd double %x14.a, %x14.b
+  %x14.next = fadd double %x14.c, %t
+  %x15.a = fmul double %x15, 9.990000e-01
+  %x15.b = fmul double %x16, 1.000000e-03
+  %x15.c = fadd double %x15.a, %x15.b
+  %x15.next = fadd double %x15.c, %t
+  %x16.a = fmul double %x16, 9.990000e-01
+  %x16.b = fmul double %x17, 1.000000e-03
+  %x16.c = fadd double %x16.a, %x16.b
+  %x16.next = fadd double %x16.c, %t
+  %x17.a = fmul double %x17, 9.990000e-01
+  %x17.b = fmul double %x18, 1.000000e-03
+  %x17.c = fadd double %x17.a, %x17.b
+  %x17.next = fadd double %x17.c, %t
+  %x18.a = fmul double %x18, 9.990000e-01
+  %x18.b = fmul double %x19, 1.000000e-03
+  %x18.c = fadd double %x18.a, %x18.b
+  %x18.next = fadd double %x18.c, %t
+  %x19.a = fmul double %x19, 9.990000e-01
+  %x19.b = fmul double %x20, 1.000000e-03
+  %x19.c = fadd double %x19.a, %x19.b
+  %x19.next = fadd double %x19.c, %t
+  %x20.a = fmul double %x20, 9.990000e-01
+  %x20.b = fmul double %x21, 1.000000e-03
+  %x20.c = fadd double %x20.a, %x20.b
+  %x20.next = fadd double %x20.c, %t
+  %x21.a = fmul double %x21, 9.990000e-01
+  %x21.b = fmul double %x22, 1.000000e-03
+  %x21.c = fadd double %x21.a, %x21.b
+  %x21.next = fadd double %x21.c, %t
+  %x22.a = fmul double %x22, 9.990000e-01
+  %x22.b = fmul double %x23, 1.000000e-03
+  %x22.c = fadd double %x22.a, %x22.b
+  %x22.next = fadd double %x22.c, %t
+  %x23.a = fmul double %x23, 9.990000e-01
+  %x23.b = fmul double %x0, 1.000000e-03
+  %x23.c = fadd double %x23.a, %x23.b
+  %x23.next = fadd double %x23.c, %t
+  %h0.m = mul i64 %h0, 6364136223846793005
+  %h0.s = lshr i64 %h1, 29
+  %h0.x = xor i64 %h0.m, %h0.s
+  %h0.next = add i64 %h0.x, 1
+  %h1.m = mul i64 %h1, 6364136223846793005
+  %h1.s = lshr i64 %h2, 29
+  %h1.x = xor i64 %h1.m, %h1.s
+  %h1.next = add i64 %h1.x, 3
+  %h2.m = mul i64 %h2, 6364136223846793005
+  %h2.s = lshr i64 %h3, 29
+  %h2.x = xor i64 %h2.m, %h2.s
+  %h2.next = add i64 %h2.x, 5
+  %h3.m = mul i64 %h3, 6364136223846793005
+  %h3.s = lshr i64 %h4, 29
+  %h3.x = xor i64 %h3.m, %h3.s
+  %h3.next = add i64 %h3.x, 7
+  %h4.m = mul i64 %h4, 6364136223846793005
+  %h4.s = lshr i64 %h5, 29
+  %h4.x = xor i64 %h4.m, %h4.s
+  %h4.next = add i64 %h4.x, 9
+  %h5.m = mul i64 %h5, 6364136223846793005
+  %h5.s = lshr i64 %h6, 29
+  %h5.x = xor i64 %h5.m, %h5.s
+  %h5.next = add i64 %h5.x, 11
+  %h6.m = mul i64 %h6, 6364136223846793005
+  %h6.s = lshr i64 %h7, 29
+  %h6.x = xor i64 %h6.m, %h6.s
+  %h6.next = add i64 %h6.x, 13
+  %h7.m = mul i64 %h7, 6364136223846793005
+  %h7.s = lshr i64 %h8, 29
+  %h7.x = xor i64 %h7.m, %h7.s
+  %h7.next = add i64 %h7.x, 15
+  %h8.m = mul i64 %h8, 6364136223846793005
+  %h8.s = lshr i64 %h9, 29
+  %h8.x = xor i64 %h8.m, %h8.s
+  %h8.next = add i64 %h8.x, 17
+  %h9.m = mul i64 %h9, 6364136223846793005
+  %h9.s = lshr i64 %h10, 29
+  %h9.x = xor i64 %h9.m, %h9.s
+  %h9.next = add i64 %h9.x, 19
+  %h10.m = mul i64 %h10, 6364136223846793005
+  %h10.s = lshr i64 %h11, 29
+  %h10.x = xor i64 %h10.m, %h10.s
+  %h10.next = add i64 %h10.x, 21
+  %h11.m = mul i64 %h11, 6364136223846793005
+  %h11.s = lshr i64 %h12, 29
+  %h11.x = xor i64 %h11.m, %h11.s
+  %h11.next = add i64 %h11.x, 23
+  %h12.m = mul i64 %h12, 6364136223846793005
+  %h12.s = lshr i64 %h13, 29
+  %h12.x = xor i64 %h12.m, %h12.s
+  %h12.next = add i64 %h12.x, 25
+  %h13.m = mul i64 %h13, 6364136223846793005
+  %h13.s = lshr i64 %h0, 29
+  %h13.x = xor i64 %h13.m, %h13.s
+  %h13.next = add i64 %h13.x, 27
+  %n.next = add i32 %n, 1
+  %done = icmp eq i32 %n.next, 5000000
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %fs0 = fadd double 0.000000e+00, %x0.next
+  %fs1 = fadd double %fs0, %x1.next
+  %fs2 = fadd double %fs1, %x2.next
+  %fs3 = fadd double %fs2, %x3.next
+  %fs4 = fadd double %fs3, %x4.next
+  %fs5 = fadd double %fs4, %x5.next
+  %fs6 = fadd double %fs5, %x6.next
+  %fs7 = fadd double %fs6, %x7.next
+  %fs8 = fadd double %fs7, %x8.next
+  %fs9 = fadd double %fs8, %x9.next
+  %fs10 = fadd double %fs9, %x10.next
+  %fs11 = fadd double %fs10, %x11.next
+  %fs12 = fadd double %fs11, %x12.next
+  %fs13 = fadd double %fs12, %x13.next
+  %fs14 = fadd double %fs13, %x14.next
+  %fs15 = fadd double %fs14, %x15.next
+  %fs16 = fadd double %fs15, %x16.next
+  %fs17 = fadd double %fs16, %x17.next
+  %fs18 = fadd double %fs17, %x18.next
+  %fs19 = fadd double %fs18, %x19.next
+  %fs20 = fadd double %fs19, %x20.next
+  %fs21 = fadd double %fs20, %x21.next
+  %fs22 = fadd double %fs21, %x22.next
+  %fs23 = fadd double %fs22, %x23.next
+  %is0 = xor i64 0, %h0.next
+  %is1 = xor i64 %is0, %h1.next
+  %is2 = xor i64 %is1, %h2.next
+  %is3 = xor i64 %is2, %h3.next
+  %is4 = xor i64 %is3, %h4.next
+  %is5 = xor i64 %is4, %h5.next
+  %is6 = xor i64 %is5, %h6.next
+  %is7 = xor i64 %is6, %h7.next
+  %is8 = xor i64 %is7, %h8.next
+  %is9 = xor i64 %is8, %h9.next
+  %is10 = xor i64 %is9, %h10.next
+  %is11 = xor i64 %is10, %h11.next
+  %is12 = xor i64 %is11, %h12.next
+  %is13 = xor i64 %is12, %h13.next
+  %fmt = getelementptr inbounds [9 x i8]* @.fmt, i64 0, i64 0
+  %call = call i32 (i8*, ...)* @printf(i8* %fmt, double %fs23, i64 %is13)
+  ret i32 0
+}
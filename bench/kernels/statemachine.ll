@@ -0,0 +1,124 @@
+; Switch-heavy state machine, the shape of generated lexers and protocol
+; handlers: a loop around a 8-way switch on the state, driven by a pseudo
+; random input. 6 counters are live across every case and merge at the latch.
+
+@.fmt = private constant [6 x i8] c"%llu\0A\00"
+
+declare i32 @printf(i8*, ...)
+
+define i32 @main() nounwind {
+entry:
+  br label %loop
+
+loop:
+  %n = phi i32 [ 0, %entry ], [ %n.next, %latch ]
+  %seed = phi i64 [ 88172645463325252, %entry ], [ %seed.next, %latch ]
+  %state = phi i32 [ 0, %entry ], [ %state.next, %latch ]
+  %c0 = phi i64 [ 0, %entry ], [ %c0.next, %latch ]
+  %c1 = phi i64 [ 0, %entry ], [ %c1.next, %latch ]
+  %c2 = phi i64 [ 0, %entry ], [ %c2.next, %latch ]
+  %c3 = phi i64 [ 0, %entry ], [ %c3.next, %latch ]
+  %c4 = phi i64 [ 0, %entry ], [ %c4.next, %latch ]
+  %c5 = phi i64 [ 0, %entry ], [ %c5.next, %latch ]
+  %seed.m = mul i64 %seed, 2862933555777941757
+  %seed.next = add i64 %seed.m, 3037000493
+  %in.64 = lshr i64 %seed.next, 45
+  %in = trunc i64 %in.64 to i32
+  %sym = and i32 %in, 7
+  switch i32 %state, label %s0 [
+    i32 1, label %s1
+    i32 2, label %s2
+    i32 3, label %s3
+    i32 4, label %s4
+    i32 5, label %s5
+    i32 6, label %s6
+    i32 7, label %s7
+  ]
+
+s0:
+  %s0.a = add i32 %sym, 1
+  %s0.next = and i32 %s0.a, 7
+  %s0.w = zext i32 %sym to i64
+  %s0.c0 = add i64 %c0, %s0.w
+  %s0.c1 = xor i64 %c1, 3
+  br label %latch
+
+s1:
+  %s1.a = add i32 %sym, 4
+  %s1.next = and i32 %s1.a, 7
+  %s1.w = zext i32 %sym to i64
+  %s1.c1 = add i64 %c1, %s1.w
+  %s1.c0 = xor i64 %c0, 10
+  br label %latch
+
+s2:
+  %s2.a = add i32 %sym, 7
+  %s2.next = and i32 %s2.a, 7
+  %s2.w = zext i32 %sym to i64
+  %s2.c2 = add i64 %c2, %s2.w
+  %s2.c5 = xor i64 %c5, 17
+  br label %latch
+
+s3:
+  %s3.a = add i32 %sym, 10
+  %s3.next = and i32 %s3.a, 7
+  %s3.w = zext i32 %sym to i64
+  %s3.c3 = add i64 %c3, %s3.w
+  %s3.c4 = xor i64 %c4, 24
+  br label %latch
+
+s4:
+  %s4.a = add i32 %sym, 13
+  %s4.next = and i32 %s4.a, 7
+  %s4.w = zext i32 %sym to i64
+  %s4.c4 = add i64 %c4, %s4.w
+  %s4.c3 = xor i64 %c3, 31
+  br label %latch
+
+s5:
+  %s5.a = add i32 %sym, 16
+  %s5.next = and i32 %s5.a, 7
+  %s5.w = zext i32 %sym to i64
+  %s5.c5 = add i64 %c5, %s5.w
+  %s5.c2 = xor i64 %c2, 38
+  br label %latch
+
+s6:
+  %s6.a = add i32 %sym, 19
+  %s6.next = and i32 %s6.a, 7
+  %s6.w = zext i32 %sym to i64
+  %s6.c0 = add i64 %c0, %s6.w
+  %s6.c1 = xor i64 %c1, 45
+  br label %latch
+
+s7:
+  %s7.a = add i32 %sym, 22
+  %s7.next = and i32 %s7.a, 7
+  %s7.w = zext i32 %sym to i64
+  %s7.c1 = add i64 %c1, %s7.w
+  %s7.c0 = xor i64 %c0, 52
+  br label %latch
+
+latch:
+  %state.next = phi i32 [ %s0.next, %s0 ], [ %s1.next, %s1 ], [ %s2.next, %s2 ], [ %s3.next, %s3 ], [ %s4.next, %s4 ], [ %s5.next, %s5 ], [ %s6.next, %s6 ], [ %s7.next, %s7 ]
+  %c0.next = phi i64 [ %s0.c0, %s0 ], [ %s1.c0, %s1 ], [ %c0, %s2 ], [ %c0, %s3 ], [ %c0, %s4 ], [ %c0, %s5 ], [ %s6.c0, %s6 ], [ %s7.c0, %s7 ]
+  %c1.next = phi i64 [ %s0.c1, %s0 ], [ %s1.c1, %s1 ], [ %c1, %s2 ], [ %c1, %s3 ], [ %c1, %s4 ], [ %c1, %s5 ], [ %s6.c1, %s6 ], [ %s7.c1, %s7 ]
+  %c2.next = phi i64 [ %c2, %s0 ], [ %c2, %s1 ], [ %s2.c2, %s2 ], [ %c2, %s3 ], [ %c2, %s4 ], [ %s5.c2, %s5 ], [ %c2, %s6 ], [ %c2, %s7 ]
+  %c3.next = phi i64 [ %c3, %s0 ], [ %c3, %s1 ], [ %c3, %s2 ], [ %s3.c3, %s3 ], [ %s4.c3, %s4 ], [ %c3, %s5 ], [ %c3, %s6 ], [ %c3, %s7 ]
+  %c4.next = phi i64 [ %c4, %s0 ], [ %c4, %s1 ], [ %c4, %s2 ], [ %s3.c4, %s3 ], [ %s4.c4, %s4 ], [ %c4, %s5 ], [ %c4, %s6 ], [ %c4, %s7 ]
+  %c5.next = phi i64 [ %c5, %s0 ], [ %c5, %s1 ], [ %s2.c5, %s2 ], [ %c5, %s3 ], [ %c5, %s4 ], [ %s5.c5, %s5 ], [ %c5, %s6 ], [ %c5, %s7 ]
+  %n.next = add i32 %n, 1
+  %done = icmp eq i32 %n.next, 20000000
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %sum0 = add i64 0, %c0.next
+  %sum1 = add i64 %sum0, %c1.next
+  %sum2 = add i64 %sum1, %c2.next
+  %sum3 = add i64 %sum2, %c3.next
+  %sum4 = add i64 %sum3, %c4.next
+  %sum5 = add i64 %sum4, %c5.next
+  %fmt = getelementptr inbounds [6 x i8]* @.fmt, i64 0, i64 0
+  %call = call i32 (i8*, ...)* @printf(i8* %fmt, i64 %sum5)
+  ret i32 0
+}
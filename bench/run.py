@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+"""Compares register allocators on the IR kernels in bench/kernels.
+
+Every kernel is compiled with llc once per allocator. The driver records:
+  - compile time (best of --repeat runs)
+  - spill and reload instructions, counted from the asm comments llc writes
+    next to them
+  - stack frame bytes, from the prologue adjustments of the stack pointer
+  - the static instruction count
+
+Unless --no-run is given, each result is linked with the C compiler and run.
+The driver then checks that every allocator prints the same output. It also
+records the dynamic instruction count when `perf stat` is available.
+
+The results are written as CSV and as a markdown report. In the report, each
+kernel gets a table, and the numbers are relative to the first allocator
+that compiled it.
+
+    bench/run.py --llc path/to/llc --allocators color1,greedy,basic,fast
+"""
+
+import argparse
+import csv
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+FIELDS = ["kernel", "allocator", "status", "compile_seconds", "spills",
+          "reloads", "frame_bytes", "static_insts", "dynamic_insts",
+          "output"]
+
+SPILL_RE = re.compile(r"#.*\bSpill\b")
+RELOAD_RE = re.compile(r"#.*\bReload\b")
+FRAME_RE = re.compile(r"^\s*sub[lq]?\s+\$(\d+),\s*%[re]sp\b")
+LABEL_RE = re.compile(r"^[^\s#][^:]*:")
+FUNC_RE = re.compile(r"^[A-Za-z_$][\w.$]*:")
+
+
+def parse_asm(path):
+    """Counts spills, reloads, frame bytes and instructions in an asm file."""
+    spills = reloads = frame = insts = 0
+    in_prologue = False
+    with open(path) as f:
+        for line in f:
+            # only the first stack adjustment of a function is its frame,
+            # later ones are call sequences or dynamic allocas
+            if FUNC_RE.match(line):
+                in_prologue = True
+            if SPILL_RE.search(line):
+                spills += 1
+            if RELOAD_RE.search(line):
+                reloads += 1
+            m = FRAME_RE.match(line)
+            if m and in_prologue:
+                frame += int(m.group(1))
+                in_prologue = False
+            code = line.split("#", 1)[0].strip()
+            if not code or code.startswith(".") or LABEL_RE.match(line):
+                continue
+            insts += 1
+    return spills, reloads, frame, insts
+
+
+def compile_kernel(args, kernel, allocator, asm):
+    """Runs llc, returns the best wall time or raises CalledProcessError."""
+    cmd = [args.llc, "-O%d" % args.opt_level, "-regalloc=" + allocator,
+           "-asm-verbose", kernel, "-o", asm] + args.llc_args
+    best = None
+    for _ in range(args.repeat):
+        start = time.time()
+        subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL,
+                       stderr=subprocess.PIPE)
+        elapsed = time.time() - start
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+
+def run_binary(args, exe):
+    """Runs the binary, returns its output and its dynamic instruction count."""
+    if args.perf:
+        csv_out = exe + ".perf"
+        try:
+            proc = subprocess.run([args.perf, "stat", "-x", ",", "-o", csv_out,
+                                   "-e", "instructions:u", exe],
+                                  check=True, stdout=subprocess.PIPE,
+                                  stderr=subprocess.DEVNULL,
+                                  timeout=args.timeout)
+        except subprocess.CalledProcessError:
+            # perf can be installed but not permitted (perf_event_paranoid),
+            # run without it and leave the count empty
+            proc = subprocess.run([exe], check=True, stdout=subprocess.PIPE,
+                                  timeout=args.timeout)
+            return proc.stdout.decode().strip(), ""
+        count = ""
+        with open(csv_out) as f:
+            for line in f:
+                fields = line.split(",")
+                if len(fields) > 2 and fields[2].startswith("instructions"):
+                    count = fields[0] if fields[0].isdigit() else ""
+        return proc.stdout.decode().strip(), count
+    proc = subprocess.run([exe], check=True, stdout=subprocess.PIPE,
+                          timeout=args.timeout)
+    return proc.stdout.decode().strip(), ""
+
+
+def measure(args, workdir, kernel, allocator):
+    name = os.path.splitext(os.path.basename(kernel))[0]
+    row = dict.fromkeys(FIELDS, "")
+    row.update(kernel=name, allocator=allocator)
+    asm = os.path.join(workdir, "%s.%s.s" % (name, allocator))
+    try:
+        row["compile_seconds"] = "%.4f" % compile_kernel(args, kernel,
+                                                         allocator, asm)
+    except subprocess.CalledProcessError as e:
+        row["status"] = "llc failed"
+        sys.stderr.write("%s/%s: %s\n" % (name, allocator,
+                                          e.stderr.decode().strip()))
+        return row
+    spills, reloads, frame, insts = parse_asm(asm)
+    row.update(spills=spills, reloads=reloads, frame_bytes=frame,
+               static_insts=insts, status="ok")
+    if args.no_run:
+        return row
+
+    exe = os.path.join(workdir, "%s.%s" % (name, allocator))
+    try:
+        subprocess.run([args.cc, asm, "-o", exe] + args.link_args,
+                       check=True, stderr=subprocess.PIPE)
+        row["output"], row["dynamic_insts"] = run_binary(args, exe)
+    except subprocess.CalledProcessError as e:
+        row["status"] = "link or run failed"
+        if e.stderr:
+            sys.stderr.write("%s/%s: %s\n" % (name, allocator,
+                                              e.stderr.decode().strip()))
+    except subprocess.TimeoutExpired:
+        row["status"] = "timed out"
+    return row
+
+
+def relative(value, base):
+    if value in ("", None) or base in ("", None) or float(base) == 0:
+        return str(value)
+    return "%s (%.2fx)" % (value, float(value) / float(base))
+
+
+def write_markdown(path, rows, allocators):
+    columns = ["compile_seconds", "spills", "reloads", "frame_bytes",
+               "static_insts", "dynamic_insts"]
+    with open(path, "w") as out:
+        out.write("# Register allocator comparison\n")
+        for kernel in sorted(set(r["kernel"] for r in rows)):
+            kernel_rows = [r for r in rows if r["kernel"] == kernel]
+            ok = [r for r in kernel_rows if r["status"] == "ok"]
+            base = ok[0] if ok else None
+            outputs = set(r["output"] for r in ok)
+            out.write("\n## %s\n\n" % kernel)
+            if len(outputs) > 1:
+                out.write("**Allocators disagree on the program output.**\n\n")
+            out.write("| allocator | status | " + " | ".join(columns) + " |\n")
+            out.write("|---" * (len(columns) + 2) + "|\n")
+            for allocator in allocators:
+                for r in kernel_rows:
+                    if r["allocator"] != allocator:
+                        continue
+                    cells = [relative(r[c], base[c]) if base and r is not base
+                             else str(r[c]) for c in columns]
+                    out.write("| %s | %s | %s |\n" % (allocator, r["status"],
+                                                      " | ".join(cells)))
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--llc", default="llc",
+                        help="llc built with the color1 allocator")
+    parser.add_argument("--cc", default="cc",
+                        help="compiler used to assemble and link")
+    parser.add_argument("--kernels", default=os.path.join(here, "kernels"))
+    parser.add_argument("--allocators", default="color1,greedy,basic,fast")
+    parser.add_argument("--opt-level", type=int, default=2)
+    parser.add_argument("--repeat", type=int, default=3,
+                        help="compile each kernel this many times, keep the best")
+    parser.add_argument("--llc-args", default="",
+                        help="extra llc arguments, e.g. '-color-coalesce=false'")
+    parser.add_argument("--link-args", default="-no-pie",
+                        help="extra arguments for linking; llc emits non-PIC "
+                             "code by default")
+    parser.add_argument("--no-run", action="store_true",
+                        help="only compile, do not link and run the kernels")
+    parser.add_argument("--perf", default=shutil.which("perf"),
+                        help="perf binary for dynamic instruction counts")
+    parser.add_argument("--timeout", type=int, default=120)
+    parser.add_argument("--workdir", help="keep asm and binaries here")
+    parser.add_argument("--csv", default="bench-results.csv")
+    parser.add_argument("--markdown", default="bench-results.md")
+    args = parser.parse_args()
+    args.llc_args = args.llc_args.split()
+    args.link_args = args.link_args.split()
+    allocators = [a for a in args.allocators.split(",") if a]
+
+    kernels = sorted(os.path.join(args.kernels, k)
+                     for k in os.listdir(args.kernels) if k.endswith(".ll"))
+    workdir = args.workdir or tempfile.mkdtemp(prefix="color-bench-")
+    os.makedirs(workdir, exist_ok=True)
+
+    rows = []
+    for kernel in kernels:
+        for allocator in allocators:
+            row = measure(args, workdir, kernel, allocator)
+            print("%-14s %-8s %-18s %s" % (row["kernel"], allocator,
+                                           row["status"],
+                                           row["compile_seconds"]))
+            rows.append(row)
+
+    with open(args.csv, "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=FIELDS)
+        writer.writeheader()
+        writer.writerows(rows)
+    write_markdown(args.markdown, rows, allocators)
+    if not args.workdir:
+        shutil.rmtree(workdir)
+    print("wrote %s and %s" % (args.csv, args.markdown))
+
+
+if __name__ == "__main__":
+    main()
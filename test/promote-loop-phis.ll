@@ -0,0 +1,42 @@
+; RUN: opt < %s -load %llvmshlibdir/LLVMRegisterPromotion%shlibext -promote -S | FileCheck %s
+; RUN: opt < %s -load %llvmshlibdir/LLVMRegisterPromotion%shlibext -promote -promote-dense-dataflow=false -S | FileCheck %s
+
+; A loop whose header is followed by a block that leaves it: the value of @g
+; merges only in the header, so that is the only block that gets a phi for it.
+
+@g = global i32 0
+
+define void @f(i32 %n) nounwind {
+; CHECK: entry:
+; CHECK: load i32* @g
+entry:
+  br label %header
+
+; CHECK: header:
+; CHECK: %g{{[0-9]*}} = phi i32
+header:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %v = load i32* @g
+  br label %body
+
+; CHECK: body:
+; CHECK-NOT: phi
+body:
+  %c = icmp slt i32 %i, %n
+  br i1 %c, label %latch, label %exit
+
+; CHECK: latch:
+; CHECK-NOT: phi
+latch:
+  %v.next = add i32 %v, %i
+  store i32 %v.next, i32* @g
+  %i.next = add i32 %i, 1
+  br label %header
+
+; CHECK: exit:
+; CHECK-NOT: phi
+; CHECK: store i32 %g{{[0-9]*}}, i32* @g
+; CHECK: ret void
+exit:
+  ret void
+}